@@ -0,0 +1,22 @@
+// Regression target of --incremental, see check-incremental.sh.
+// Differs from incremental_callers_base.c only in the body of wrapper, whose
+// returned state reaches main through two levels of callers.
+extern char * __rust_alloc(long long int x1, long long int x2);
+extern char * box_into_raw(char * b);
+extern void drop_in_place(char * p);
+
+char * wrapper(char * b) {
+    return box_into_raw(b);
+}
+
+char * middle(char * b) {
+    return wrapper(b);
+}
+
+int main() {
+    char * b = __rust_alloc(16, 16);
+    char * p = middle(b);
+    drop_in_place(p);
+    drop_in_place(p);
+    return 0;
+}
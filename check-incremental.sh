@@ -0,0 +1,34 @@
+#! /usr/bin/env bash
+
+# Regression check of the incremental mode of unsafe-drop-ts: the state written for BASE
+# is reused on CHANGED, a module with the same functions of which some bodies changed,
+# and the findings have to be the same as those of a full run on CHANGED.
+# Usage: check-incremental.sh [BASE CHANGED], by default the incremental_callers pair of c-tests.
+# UNSAFE_DROP_TS selects the binary, by default the one in ./build.
+
+set -o pipefail
+
+UNSAFE_DROP_TS=${UNSAFE_DROP_TS:-./build/tools/unsafe-drop-ts/unsafe-drop-ts}
+BASE=${1:-build/analysis-targets/c-tests/incremental_callers_base_c.ll}
+CHANGED=${2:-build/analysis-targets/c-tests/incremental_callers_changed_c.ll}
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "${WORKDIR}"' EXIT
+
+run() {
+    "${UNSAFE_DROP_TS}" "$@" > "${WORKDIR}/log" 2>&1 || { cat "${WORKDIR}/log"; echo "Analysis failed: $*"; exit 1; }
+}
+
+echo "Writing the incremental state of ${BASE}..."
+run "${BASE}" --incremental "${WORKDIR}/state.json"
+echo "Reusing it on ${CHANGED}..."
+run "${CHANGED}" --incremental "${WORKDIR}/state.json" --findings "${WORKDIR}/incremental.jsonl"
+echo "Full run on ${CHANGED}..."
+run "${CHANGED}" --findings "${WORKDIR}/full.jsonl"
+
+# the order of the findings within a section does not matter here
+if ! diff <(sort "${WORKDIR}/full.jsonl") <(sort "${WORKDIR}/incremental.jsonl"); then
+    echo "Incremental findings differ from the full run (<: full, >: incremental)."
+    exit 1
+fi
+echo "Incremental findings match the full run."
@@ -0,0 +1,28 @@
+#! /usr/bin/env bash
+
+# Cross-check the typestate engines against the IDE solver on the analysis targets,
+# by default on all targets copied by build.sh, or on the LLVM IR files given as arguments.
+# ENGINE selects the mode of unsafe-drop-ts that runs the IDE solver next to the other engines,
+# 'all' (default) checks the bit-vector and the demand engine, 'both' only the bit-vector engine.
+
+set -o pipefail
+
+ENGINE=${ENGINE:-all}
+TARGETS=("$@")
+if [ ${#TARGETS[@]} -eq 0 ]; then
+    TARGETS=(build/analysis-targets/*.ll)
+fi
+
+NUM_FAILED_TARGETS=0
+for x in "${TARGETS[@]}"; do
+    echo "Comparing engines on ${x}..."
+    OUTPUT=$(./build/tools/unsafe-drop-ts/unsafe-drop-ts "${x}" --engine "${ENGINE}" 2>&1) || { echo "Analysis of ${x} failed."; NUM_FAILED_TARGETS=$((NUM_FAILED_TARGETS+1)); continue; }
+    if echo "${OUTPUT}" | grep -qE "^[1-9][0-9]* values with differing DF/UAF findings"; then
+        echo "${OUTPUT}" | sed -n '/^DF\/UAF findings of only one/,/values with differing DF\/UAF findings$/p'
+        echo "Engines differ on ${x}."
+        NUM_FAILED_TARGETS=$((NUM_FAILED_TARGETS+1))
+    fi
+done
+
+echo "${NUM_FAILED_TARGETS} targets with differing findings"
+[ "${NUM_FAILED_TARGETS}" -eq 0 ]
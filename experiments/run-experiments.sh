@@ -2,8 +2,9 @@
 set -x
 mkdir -p psr-output
 # find crates -type f -name '*.ll' | grep deps | uniq | tee ll_files.txt
-while read llfile; do
-    outdir="psr-output/${llfile}/"
-    mkdir -p ${outdir}
-    (ulimit -v 2000000; ./bin/unsafe-drop-ts ${llfile} &>${outdir}/psr.log)
-done <ll_files.txt
+# every file is analyzed in its own process, logs go to psr-output/<file>/psr.log,
+# one result record per file is written to psr-output/batch-results.jsonl
+./bin/unsafe-drop-ts --batch ll_files.txt \
+    --jobs "$(nproc)" \
+    --mem-limit-mb 1953 \
+    --output-dir psr-output
@@ -9,6 +9,27 @@
 
 typedef struct FindUnsafeRs FindUnsafeRs;
 
+/**
+ * A single location query for `find_unsafe_rs_is_any_unsafe_location_batch`
+ */
+typedef struct FindUnsafeRsQuery {
+  const char *path;
+  unsigned int line;
+  unsigned int column;
+} FindUnsafeRsQuery;
+
+/**
+ * The result of a single `FindUnsafeRsQuery`
+ *
+ * `status` is 0 on success, errno or negative value on error
+ *
+ * `is_unsafe` is 1 if any unsafe location matches, 0 otherwise or on error
+ */
+typedef struct FindUnsafeRsResult {
+  int status;
+  int is_unsafe;
+} FindUnsafeRsResult;
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -45,6 +66,23 @@ int find_unsafe_rs_is_any_unsafe_location(const struct FindUnsafeRs *f,
                                           unsigned int column,
                                           int *out_ret);
 
+/**
+ * Batch version of `find_unsafe_rs_is_any_unsafe_location`
+ *
+ * Answers num_queries queries and writes one result per query into
+ * out_results, which must have space for num_queries results.
+ * Queries are grouped by file, every file is analyzed at most once and
+ * locked only once for all of its queries.
+ *
+ * Returns 0 on success, the status of every single query is written to its result
+ *
+ * Returns EINVAL if any pointer is null
+ */
+int find_unsafe_rs_is_any_unsafe_location_batch(const struct FindUnsafeRs *f,
+                                                const struct FindUnsafeRsQuery *queries,
+                                                size_t num_queries,
+                                                struct FindUnsafeRsResult *out_results);
+
 /**
  * Allocate a new instance of `FindUnsafeRs``
  *
@@ -52,6 +90,35 @@ int find_unsafe_rs_is_any_unsafe_location(const struct FindUnsafeRs *f,
  */
 struct FindUnsafeRs *find_unsafe_rs_new(void);
 
+/**
+ * Allocate a new instance of `FindUnsafeRs` that stores parse results in
+ * and loads them from the directory cache_dir, see `FindUnsafeRs::with_cache_dir`
+ *
+ * Must be freed by calling `find_unsafe_rs_free` on it
+ *
+ * Returns null if cache_dir is null
+ */
+struct FindUnsafeRs *find_unsafe_rs_new_with_cache(const char *cache_dir);
+
+/**
+ * Analyze the given source files up front on a pool of num_threads threads,
+ * or one per core if num_threads is 0, so that later queries are only lookups.
+ * Every file is parsed once, also if it is listed several times.
+ *
+ * If out_statuses is not null, it must have space for num_paths statuses,
+ * the status of every path is written to it: 0 on success, errno or negative
+ * value on error
+ *
+ * Returns 0 on success
+ *
+ * Returns EINVAL if any pointer except out_statuses is null
+ */
+int find_unsafe_rs_prepare_files(const struct FindUnsafeRs *f,
+                                 const char *const *paths,
+                                 size_t num_paths,
+                                 unsigned int num_threads,
+                                 int *out_statuses);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
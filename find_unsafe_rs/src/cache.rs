@@ -0,0 +1,242 @@
+//! On-disk cache of `UnsafeLocations`, shared by all runs on a machine.
+//!
+//! Every analyzed file gets one entry `<dir>/<key>.ful`, where key is a hash of
+//! the path, size and mtime of the source file. The entry repeats these, so a
+//! hash collision or a stale entry is a cache miss, never a wrong result.
+//!
+//! Entry layout (all integers little endian):
+//!
+//! ```text
+//! magic "FURC" | version u32 | size u64 | mtime secs i64 | mtime nanos u32
+//! | path len u32 | path bytes | num spans u32
+//! | spans: start line u32 | start col u32 | end line u32 | end col u32
+//!          | kind u8 | name len u32 | name bytes
+//! ```
+//!
+//! Entries are read through a read-only mmap and written to a temporary file
+//! that is renamed into place, so concurrent runs never see partial entries.
+
+use crate::{SimpleSpan, UnsafeLocationKind, UnsafeLocations};
+use proc_macro2::LineColumn;
+use std::fs::{self, File};
+use std::io::{self, Write};
+use std::os::unix::ffi::OsStrExt;
+use std::os::unix::fs::MetadataExt;
+use std::os::unix::io::AsRawFd;
+use std::path::{Path, PathBuf};
+
+const MAGIC: &[u8; 4] = b"FURC";
+// bump whenever the layout or the meaning of an entry changes
+const VERSION: u32 = 1;
+
+const KIND_BLOCK: u8 = 0;
+const KIND_FUNCTION: u8 = 1;
+const KIND_TRAIT: u8 = 2;
+const KIND_IMPL: u8 = 3;
+
+/// Identity of a source file as far as the cache is concerned
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub(crate) struct SourceStamp {
+    size: u64,
+    mtime_secs: i64,
+    mtime_nanos: u32,
+}
+
+impl SourceStamp {
+    pub(crate) fn of(path: &Path) -> io::Result<Self> {
+        let meta = fs::metadata(path)?;
+        Ok(SourceStamp {
+            size: meta.size(),
+            mtime_secs: meta.mtime(),
+            mtime_nanos: meta.mtime_nsec() as u32,
+        })
+    }
+}
+
+fn fnv1a(hash: u64, bytes: &[u8]) -> u64 {
+    bytes.iter().fold(hash, |h, &b| {
+        (h ^ b as u64).wrapping_mul(0x0000_0100_0000_01b3)
+    })
+}
+
+fn entry_path(dir: &Path, path: &Path, stamp: &SourceStamp) -> PathBuf {
+    let mut hash = 0xcbf2_9ce4_8422_2325;
+    hash = fnv1a(hash, path.as_os_str().as_bytes());
+    hash = fnv1a(hash, &stamp.size.to_le_bytes());
+    hash = fnv1a(hash, &stamp.mtime_secs.to_le_bytes());
+    hash = fnv1a(hash, &stamp.mtime_nanos.to_le_bytes());
+    dir.join(format!("{:016x}.ful", hash))
+}
+
+/// Read-only mapping of a whole file, unmapped on drop
+struct Mmap {
+    ptr: *mut libc::c_void,
+    len: usize,
+}
+
+impl Mmap {
+    fn open(path: &Path) -> io::Result<Self> {
+        let file = File::open(path)?;
+        let len = file.metadata()?.len() as usize;
+        if len == 0 {
+            return Err(io::ErrorKind::UnexpectedEof.into());
+        }
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Mmap { ptr, len })
+    }
+
+    fn bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr as *const u8, self.len) }
+    }
+}
+
+impl Drop for Mmap {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(self.ptr, self.len);
+        }
+    }
+}
+
+/// Cursor over the bytes of an entry, every read fails on truncated input
+struct Reader<'a> {
+    bytes: &'a [u8],
+}
+
+impl<'a> Reader<'a> {
+    fn take(&mut self, n: usize) -> Option<&'a [u8]> {
+        if self.bytes.len() < n {
+            return None;
+        }
+        let (head, tail) = self.bytes.split_at(n);
+        self.bytes = tail;
+        Some(head)
+    }
+    fn u8(&mut self) -> Option<u8> {
+        Some(self.take(1)?[0])
+    }
+    fn u32(&mut self) -> Option<u32> {
+        Some(u32::from_le_bytes(self.take(4)?.try_into().ok()?))
+    }
+    fn u64(&mut self) -> Option<u64> {
+        Some(u64::from_le_bytes(self.take(8)?.try_into().ok()?))
+    }
+    fn i64(&mut self) -> Option<i64> {
+        Some(i64::from_le_bytes(self.take(8)?.try_into().ok()?))
+    }
+    fn bytes(&mut self) -> Option<&'a [u8]> {
+        let len = self.u32()? as usize;
+        self.take(len)
+    }
+    fn line_column(&mut self) -> Option<LineColumn> {
+        Some(LineColumn {
+            line: self.u32()? as usize,
+            column: self.u32()? as usize,
+        })
+    }
+}
+
+fn decode(bytes: &[u8], path: &Path, stamp: &SourceStamp) -> Option<UnsafeLocations> {
+    let mut r = Reader { bytes };
+    if r.take(4)? != MAGIC || r.u32()? != VERSION {
+        return None;
+    }
+    let entry_stamp = SourceStamp {
+        size: r.u64()?,
+        mtime_secs: r.i64()?,
+        mtime_nanos: r.u32()?,
+    };
+    if entry_stamp != *stamp || r.bytes()? != path.as_os_str().as_bytes() {
+        return None;
+    }
+    let num_spans = r.u32()? as usize;
+    let mut spans = Vec::with_capacity(num_spans.min(r.bytes.len() / 21));
+    for _ in 0..num_spans {
+        let span = SimpleSpan {
+            start: r.line_column()?,
+            end: r.line_column()?,
+        };
+        let kind_tag = r.u8()?;
+        let name = String::from_utf8(r.bytes()?.to_vec()).ok()?;
+        let kind = match kind_tag {
+            KIND_BLOCK => UnsafeLocationKind::Block,
+            KIND_FUNCTION => UnsafeLocationKind::Function(name),
+            KIND_TRAIT => UnsafeLocationKind::Trait(name),
+            KIND_IMPL => UnsafeLocationKind::Impl,
+            _ => return None,
+        };
+        spans.push((span, kind));
+    }
+    if !r.bytes.is_empty() {
+        return None;
+    }
+    Some(UnsafeLocations::new(spans))
+}
+
+fn encode(locations: &UnsafeLocations, path: &Path, stamp: &SourceStamp) -> Vec<u8> {
+    fn put_bytes(out: &mut Vec<u8>, bytes: &[u8]) {
+        out.extend_from_slice(&(bytes.len() as u32).to_le_bytes());
+        out.extend_from_slice(bytes);
+    }
+    let mut out = Vec::new();
+    out.extend_from_slice(MAGIC);
+    out.extend_from_slice(&VERSION.to_le_bytes());
+    out.extend_from_slice(&stamp.size.to_le_bytes());
+    out.extend_from_slice(&stamp.mtime_secs.to_le_bytes());
+    out.extend_from_slice(&stamp.mtime_nanos.to_le_bytes());
+    put_bytes(&mut out, path.as_os_str().as_bytes());
+    out.extend_from_slice(&(locations.spans.len() as u32).to_le_bytes());
+    for (span, kind) in &locations.spans {
+        for lc in [span.start, span.end] {
+            out.extend_from_slice(&(lc.line as u32).to_le_bytes());
+            out.extend_from_slice(&(lc.column as u32).to_le_bytes());
+        }
+        let (tag, name) = match kind {
+            UnsafeLocationKind::Block => (KIND_BLOCK, ""),
+            UnsafeLocationKind::Function(name) => (KIND_FUNCTION, name.as_str()),
+            UnsafeLocationKind::Trait(name) => (KIND_TRAIT, name.as_str()),
+            UnsafeLocationKind::Impl => (KIND_IMPL, ""),
+        };
+        out.push(tag);
+        put_bytes(&mut out, name.as_bytes());
+    }
+    out
+}
+
+/// The cached locations of the file, if there is a valid entry for its current stamp
+pub(crate) fn load(dir: &Path, path: &Path, stamp: &SourceStamp) -> Option<UnsafeLocations> {
+    let map = Mmap::open(&entry_path(dir, path, stamp)).ok()?;
+    decode(map.bytes(), path, stamp)
+}
+
+/// Store the locations of the file, errors are returned but may be ignored
+pub(crate) fn store(
+    dir: &Path,
+    path: &Path,
+    stamp: &SourceStamp,
+    locations: &UnsafeLocations,
+) -> io::Result<()> {
+    fs::create_dir_all(dir)?;
+    let entry = entry_path(dir, path, stamp);
+    let tmp = entry.with_extension(format!("ful.tmp.{}", std::process::id()));
+    {
+        let mut file = File::create(&tmp)?;
+        file.write_all(&encode(locations, path, stamp))?;
+    }
+    fs::rename(&tmp, &entry).map_err(|e| {
+        let _ = fs::remove_file(&tmp);
+        e
+    })
+}
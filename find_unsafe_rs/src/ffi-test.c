@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <errno.h>
+#include <stdlib.h>
 #include "find_unsafe_rs.h"
 
 void file_unsafe_01() {
@@ -212,6 +213,102 @@ void analyze_files() {
     printf("ok.\n");
 }
 
+void batch_multiple_files() {
+    printf("test batch_multiple_files ...");
+
+    int err = 0;
+    struct FindUnsafeRs *f = find_unsafe_rs_new();
+
+    struct FindUnsafeRsQuery queries[] = {
+        {"test/unsafe-01.rs", 7, 22},
+        {"test/unsafe-02.rs", 12, 13},
+        {"test/does-not-exist.rs", 1, 1},
+        {"test/unsafe-01.rs", 5, 13},
+        {"test/unsafe-02.rs", 14, 22},
+    };
+    struct FindUnsafeRsResult results[5];
+
+    err = find_unsafe_rs_is_any_unsafe_location_batch(f, queries, 5, results);
+    assert(err == 0);
+    assert(results[0].status == 0 && results[0].is_unsafe == 1);
+    assert(results[1].status == 0 && results[1].is_unsafe == 0);
+    assert(results[2].status == ENOENT);
+    assert(results[3].status == 0 && results[3].is_unsafe == 0);
+    assert(results[4].status == 0 && results[4].is_unsafe == 1);
+
+    err = find_unsafe_rs_is_any_unsafe_location_batch(f, NULL, 5, results);
+    assert(err == EINVAL);
+
+    err = find_unsafe_rs_is_any_unsafe_location_batch(f, NULL, 0, NULL);
+    assert(err == 0);
+
+    find_unsafe_rs_free(f);
+
+    printf("ok.\n");
+}
+
+void prepare_files() {
+    printf("test prepare_files ...");
+
+    int err = 0;
+    struct FindUnsafeRs *f = find_unsafe_rs_new();
+    int b = 0;
+
+    const char *paths[] = {
+        "test/unsafe-01.rs",
+        "test/unsafe-02.rs",
+        "test/does-not-exist.rs",
+        "test/unsafe-01.rs",
+    };
+    int statuses[4];
+
+    err = find_unsafe_rs_prepare_files(f, paths, 4, 0, statuses);
+    assert(err == 0);
+    assert(statuses[0] == 0);
+    assert(statuses[1] == 0);
+    assert(statuses[2] == ENOENT);
+    assert(statuses[3] == 0);
+
+    err = find_unsafe_rs_prepare_files(f, paths, 4, 2, NULL);
+    assert(err == 0);
+
+    err = find_unsafe_rs_is_any_unsafe_location(f, paths[0], 7, 22, &b);
+    assert(err == 0);
+    assert(b == 1);
+
+    err = find_unsafe_rs_prepare_files(f, NULL, 4, 0, statuses);
+    assert(err == EINVAL);
+
+    find_unsafe_rs_free(f);
+
+    printf("ok.\n");
+}
+
+void new_with_cache() {
+    printf("test new_with_cache ...");
+
+    int err = 0;
+    int b = 0;
+    char cache_dir[] = "/tmp/find-unsafe-rs-ffi-test-XXXXXX";
+    assert(mkdtemp(cache_dir) != NULL);
+
+    assert(find_unsafe_rs_new_with_cache(NULL) == NULL);
+
+    for (int run = 0; run < 2; run++) {
+        struct FindUnsafeRs *f = find_unsafe_rs_new_with_cache(cache_dir);
+        assert(f != NULL);
+        err = find_unsafe_rs_is_any_unsafe_location(f, "test/unsafe-01.rs", 7, 22, &b);
+        assert(err == 0);
+        assert(b == 1);
+        err = find_unsafe_rs_is_any_unsafe_location(f, "test/unsafe-01.rs", 5, 13, &b);
+        assert(err == 0);
+        assert(b == 0);
+        find_unsafe_rs_free(f);
+    }
+
+    printf("ok.\n");
+}
+
 void new_free() {
     printf("test new_free ...");
 
@@ -231,6 +328,9 @@ int main() {
     file_unsafe_04();
     multiple_files();
     analyze_files();
+    batch_multiple_files();
+    prepare_files();
+    new_with_cache();
     printf("Tests finished.\n");
     return 0;
 }
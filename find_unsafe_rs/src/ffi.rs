@@ -1,6 +1,8 @@
 use crate::{Error, FindUnsafeRs};
 use proc_macro2::LineColumn;
-use std::ffi::CStr;
+use std::ffi::{CStr, OsStr};
+use std::os::unix::ffi::OsStrExt;
+use std::path::Path;
 
 /// Allocate a new instance of `FindUnsafeRs``
 ///
@@ -10,6 +12,23 @@ extern "C" fn find_unsafe_rs_new() -> Box<FindUnsafeRs> {
     Box::new(FindUnsafeRs::new())
 }
 
+/// Allocate a new instance of `FindUnsafeRs` that stores parse results in
+/// and loads them from the directory cache_dir, see `FindUnsafeRs::with_cache_dir`
+///
+/// Must be freed by calling `find_unsafe_rs_free` on it
+///
+/// Returns null if cache_dir is null
+#[no_mangle]
+extern "C" fn find_unsafe_rs_new_with_cache(
+    cache_dir: *const libc::c_char,
+) -> Option<Box<FindUnsafeRs>> {
+    if cache_dir.is_null() {
+        return None;
+    }
+    let cache_dir = unsafe { Path::new(OsStr::from_bytes(CStr::from_ptr(cache_dir).to_bytes())) };
+    Some(Box::new(FindUnsafeRs::with_cache_dir(cache_dir)))
+}
+
 /// Free an instance of `FindUnsafeRs` that was previously allocated using
 /// `find_unsafe_rs_new``
 #[no_mangle]
@@ -60,7 +79,7 @@ extern "C" fn find_unsafe_rs_is_any_unsafe_location(
         return libc::EINVAL;
     }
     unsafe {
-        let path = String::from_utf8_lossy(CStr::from_ptr(path).to_bytes()).to_string();
+        let path = Path::new(OsStr::from_bytes(CStr::from_ptr(path).to_bytes()));
         let location = LineColumn {
             line: line as usize,
             column: column as usize,
@@ -75,12 +94,157 @@ extern "C" fn find_unsafe_rs_is_any_unsafe_location(
     0
 }
 
+/// A single location query for `find_unsafe_rs_is_any_unsafe_location_batch`
+#[repr(C)]
+pub struct FindUnsafeRsQuery {
+    pub path: *const libc::c_char,
+    pub line: libc::c_uint,
+    pub column: libc::c_uint,
+}
+
+/// The result of a single `FindUnsafeRsQuery`
+///
+/// `status` is 0 on success, errno or negative value on error
+///
+/// `is_unsafe` is 1 if any unsafe location matches, 0 otherwise or on error
+#[repr(C)]
+pub struct FindUnsafeRsResult {
+    pub status: libc::c_int,
+    pub is_unsafe: libc::c_int,
+}
+
+/// Batch version of `find_unsafe_rs_is_any_unsafe_location`
+///
+/// Answers num_queries queries and writes one result per query into
+/// out_results, which must have space for num_queries results.
+/// Queries are grouped by file, every file is analyzed at most once and
+/// locked only once for all of its queries.
+///
+/// Returns 0 on success, the status of every single query is written to its result
+///
+/// Returns EINVAL if any pointer is null
+#[no_mangle]
+extern "C" fn find_unsafe_rs_is_any_unsafe_location_batch(
+    f: *const FindUnsafeRs,
+    queries: *const FindUnsafeRsQuery,
+    num_queries: usize,
+    out_results: *mut FindUnsafeRsResult,
+) -> libc::c_int {
+    if num_queries == 0 {
+        return 0;
+    }
+    if f.is_null() || queries.is_null() || out_results.is_null() {
+        return libc::EINVAL;
+    }
+    unsafe {
+        let queries = std::slice::from_raw_parts(queries, num_queries);
+        let results = std::slice::from_raw_parts_mut(out_results, num_queries);
+        if queries.iter().any(|q| q.path.is_null()) {
+            return libc::EINVAL;
+        }
+        let paths: Vec<&[u8]> = queries
+            .iter()
+            .map(|q| CStr::from_ptr(q.path).to_bytes())
+            .collect();
+        let mut order: Vec<usize> = (0..num_queries).collect();
+        order.sort_by_key(|&i| paths[i]);
+
+        let mut group_start = 0;
+        while group_start < order.len() {
+            let path_bytes = paths[order[group_start]];
+            let mut group_end = group_start + 1;
+            while group_end < order.len() && paths[order[group_end]] == path_bytes {
+                group_end += 1;
+            }
+            let group = &order[group_start..group_end];
+
+            let path = Path::new(OsStr::from_bytes(path_bytes));
+            let locations: Vec<LineColumn> = group
+                .iter()
+                .map(|&i| LineColumn {
+                    line: queries[i].line as usize,
+                    column: queries[i].column as usize,
+                })
+                .collect();
+            match (*f).is_any_unsafe_location_batch(path, &locations) {
+                Ok(matches) => {
+                    for (&i, b) in group.iter().zip(matches) {
+                        results[i] = FindUnsafeRsResult {
+                            status: 0,
+                            is_unsafe: b as libc::c_int,
+                        };
+                    }
+                }
+                Err(e) => {
+                    let status = e.status_code();
+                    for &i in group {
+                        results[i] = FindUnsafeRsResult {
+                            status,
+                            is_unsafe: 0,
+                        };
+                    }
+                }
+            }
+            group_start = group_end;
+        }
+    }
+    0
+}
+
+/// Analyze the given source files up front on a pool of num_threads threads,
+/// or one per core if num_threads is 0, so that later queries are only lookups.
+/// Every file is parsed once, also if it is listed several times.
+///
+/// If out_statuses is not null, it must have space for num_paths statuses,
+/// the status of every path is written to it: 0 on success, errno or negative
+/// value on error
+///
+/// Returns 0 on success
+///
+/// Returns EINVAL if any pointer except out_statuses is null
+#[no_mangle]
+extern "C" fn find_unsafe_rs_prepare_files(
+    f: *const FindUnsafeRs,
+    paths: *const *const libc::c_char,
+    num_paths: usize,
+    num_threads: libc::c_uint,
+    out_statuses: *mut libc::c_int,
+) -> libc::c_int {
+    if num_paths == 0 {
+        return 0;
+    }
+    if f.is_null() || paths.is_null() {
+        return libc::EINVAL;
+    }
+    unsafe {
+        let paths = std::slice::from_raw_parts(paths, num_paths);
+        if paths.iter().any(|p| p.is_null()) {
+            return libc::EINVAL;
+        }
+        let paths: Vec<&Path> = paths
+            .iter()
+            .map(|&p| Path::new(OsStr::from_bytes(CStr::from_ptr(p).to_bytes())))
+            .collect();
+        let results = (*f).prepare_files(&paths, num_threads as usize);
+        if !out_statuses.is_null() {
+            let statuses = std::slice::from_raw_parts_mut(out_statuses, num_paths);
+            for (status, result) in statuses.iter_mut().zip(results) {
+                *status = match result {
+                    Ok(()) => 0,
+                    Err(e) => e.status_code(),
+                };
+            }
+        }
+    }
+    0
+}
+
 impl Error {
     fn status_code(&self) -> libc::c_int {
         match *self {
             Error::FileError(ref e) => e.raw_os_error().unwrap_or(libc::EIO),
             Error::ParseError(_) => -16,
-            Error::RwLockError => libc::ENOLCK,
+            Error::RwLockError | Error::MutexError => libc::ENOLCK,
         }
     }
 }
@@ -1,13 +1,16 @@
 #![allow(dead_code)]
 
+mod cache;
 mod ffi;
 
 #[cfg(test)]
 mod test;
 
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::io;
 use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Condvar, Mutex};
 use std::{fs::File, io::Read};
 
 use proc_macro2::{LineColumn, Span};
@@ -89,20 +92,39 @@ impl SimpleSpan {
 #[derive(Debug, Default)]
 pub struct FindUnsafeRs {
     inner: std::sync::RwLock<HashMap<PathBuf, UnsafeLocations>>,
+    // files that are being parsed right now, so that concurrent queries wait instead of parsing again
+    pending: Mutex<HashSet<PathBuf>>,
+    parsed: Condvar,
+    cache_dir: Option<PathBuf>,
 }
 
 impl FindUnsafeRs {
     pub fn new() -> Self {
         Self::default()
     }
+
+    /// Like `new`, but parse results are also stored in and loaded from `cache_dir`,
+    /// keyed by path, size and mtime of the source file, so unchanged files
+    /// (e.g. the sources of the Rust toolchain) are parsed only once per machine.
+    /// The directory is created when the first entry is stored.
+    pub fn with_cache_dir<P: Into<PathBuf>>(cache_dir: P) -> Self {
+        FindUnsafeRs {
+            cache_dir: Some(cache_dir.into()),
+            ..Self::default()
+        }
+    }
 }
 
+/// All unsafe locations of a file, as a span index sorted by start location.
+///
+/// `max_end[i]` is the maximum end location of `spans[..=i]`. All spans that can
+/// contain a location are a prefix of `spans` (those starting before it), and a
+/// span of that prefix contains the location iff its end is not before it, so
+/// `is_any_matching` is a binary search plus a single comparison.
 #[derive(Debug, Clone, Default)]
 pub struct UnsafeLocations {
-    blocks: Vec<SimpleSpan>,
-    functions: Vec<(SimpleSpan, String)>,
-    traits: Vec<(SimpleSpan, String)>,
-    impls: Vec<SimpleSpan>,
+    spans: Vec<(SimpleSpan, UnsafeLocationKind)>,
+    max_end: Vec<LineColumn>,
 }
 
 #[derive(Debug, thiserror::Error)]
@@ -113,53 +135,164 @@ pub enum Error {
     ParseError(#[from] syn::Error),
     #[error("read write lock poisoned")]
     RwLockError,
+    #[error("mutex poisoned")]
+    MutexError,
 }
 
 impl FindUnsafeRs {
     pub fn analyze_file<P: AsRef<Path>>(&self, path: P) -> Result<(), Error> {
         let filename = PathBuf::from(path.as_ref());
-        let mut file = File::open(&filename)?;
+        let locations = match &self.cache_dir {
+            Some(dir) => Self::load_or_parse_locations(dir, &filename)?,
+            None => Self::parse_locations(&filename)?,
+        };
+        self.inner
+            .write()
+            .map_err(|_| Error::RwLockError)?
+            .insert(filename, locations);
+        Ok(())
+    }
+
+    fn load_or_parse_locations(cache_dir: &Path, filename: &Path) -> Result<UnsafeLocations, Error> {
+        // relative paths name different files in different working directories
+        let key = std::fs::canonicalize(filename)?;
+        let stamp = cache::SourceStamp::of(&key)?;
+        if let Some(locations) = cache::load(cache_dir, &key, &stamp) {
+            return Ok(locations);
+        }
+        let locations = Self::parse_locations(filename)?;
+        // a cache that cannot be written only costs the next run a parse
+        let _ = cache::store(cache_dir, &key, &stamp, &locations);
+        Ok(locations)
+    }
+
+    fn parse_locations(filename: &Path) -> Result<UnsafeLocations, Error> {
+        let mut file = File::open(filename)?;
         let mut src = String::new();
         file.read_to_string(&mut src)?;
         let ast = syn::parse_file(&src)?;
         let mut visitor = UnsafeVisitor::new();
         visitor.visit_file(&ast);
 
-        let locations = UnsafeLocations {
-            blocks: visitor.unsafe_blocks.into_keys().collect(),
-            functions: visitor
-                .unsafe_fns
-                .into_iter()
-                .map(|(k, v)| (k, v.sig.ident.to_string()))
-                // FIXME: should this be an distinct field in UnsafeLocations?
+        let locations = UnsafeLocations::new(
+            std::iter::empty()
+                .chain(
+                    visitor
+                        .unsafe_blocks
+                        .into_keys()
+                        .map(|k| (k, UnsafeLocationKind::Block)),
+                )
+                .chain(
+                    visitor
+                        .unsafe_fns
+                        .into_iter()
+                        .map(|(k, v)| (k, UnsafeLocationKind::Function(v.sig.ident.to_string()))),
+                )
+                // FIXME: should this be an distinct kind in UnsafeLocations?
                 .chain(
                     visitor
                         .unsafe_impl_fns
                         .into_iter()
-                        .map(|(k, v)| (k, v.sig.ident.to_string())),
+                        .map(|(k, v)| (k, UnsafeLocationKind::Function(v.sig.ident.to_string()))),
+                )
+                .chain(
+                    visitor
+                        .unsafe_traits
+                        .into_iter()
+                        .map(|(k, v)| (k, UnsafeLocationKind::Trait(v.ident.to_string()))),
+                )
+                .chain(
+                    visitor
+                        .unsafe_impls
+                        .into_keys()
+                        .map(|k| (k, UnsafeLocationKind::Impl)),
                 )
                 .collect(),
-            traits: visitor
-                .unsafe_traits
-                .into_iter()
-                .map(|(k, v)| (k, v.ident.to_string()))
-                .collect(),
-            impls: visitor.unsafe_impls.into_keys().collect(),
-        };
-        self.inner
-            .write()
-            .map_err(|_| Error::RwLockError)?
-            .insert(filename, locations);
-        Ok(())
+        );
+        Ok(locations)
+    }
+
+    /// Analyze the file unless that has already been done.
+    ///
+    /// A file is parsed only once, also if it is queried from several threads
+    /// at the same time: the first thread parses it, the others wait for it.
+    /// If parsing fails, the next query tries again.
+    fn ensure_analyzed(&self, path: &Path) -> Result<(), Error> {
+        if self.already_analyzed(path)? {
+            return Ok(());
+        }
+        {
+            let mut pending = self.pending.lock().map_err(|_| Error::MutexError)?;
+            loop {
+                // checked while holding `pending`, a parsing thread leaves it only after inserting the result
+                if self.already_analyzed(path)? {
+                    return Ok(());
+                }
+                if !pending.contains(path) {
+                    break;
+                }
+                pending = self.parsed.wait(pending).map_err(|_| Error::MutexError)?;
+            }
+            pending.insert(path.to_path_buf());
+        }
+        let result = self.analyze_file(path);
+        self.pending
+            .lock()
+            .map_err(|_| Error::MutexError)?
+            .remove(path);
+        self.parsed.notify_all();
+        result
+    }
+
+    /// Analyze all files up front on `num_threads` threads, or one per core if 0,
+    /// so that later queries are only lookups. Duplicate paths are parsed once.
+    ///
+    /// Returns the result for every path.
+    pub fn prepare_files<P: AsRef<Path> + Sync>(
+        &self,
+        paths: &[P],
+        num_threads: usize,
+    ) -> Vec<Result<(), Error>> {
+        let num_threads = match num_threads {
+            0 => std::thread::available_parallelism().map_or(1, |n| n.get()),
+            n => n,
+        }
+        .min(paths.len())
+        .max(1);
+        let next = AtomicUsize::new(0);
+        let mut results: Vec<Result<(), Error>> = paths.iter().map(|_| Ok(())).collect();
+        std::thread::scope(|scope| {
+            let workers: Vec<_> = (0..num_threads)
+                .map(|_| {
+                    scope.spawn(|| {
+                        let mut worker_results = Vec::new();
+                        loop {
+                            let i = next.fetch_add(1, Ordering::Relaxed);
+                            if i >= paths.len() {
+                                break;
+                            }
+                            worker_results.push((i, self.ensure_analyzed(paths[i].as_ref())));
+                        }
+                        worker_results
+                    })
+                })
+                .collect();
+            for worker in workers {
+                // NOTE(unwrap): parsing does not panic, a panic is propagated
+                for (i, result) in worker.join().unwrap() {
+                    results[i] = result;
+                }
+            }
+        });
+        results
     }
 
     pub fn already_analyzed<P: AsRef<Path>>(&self, path: P) -> Result<bool, Error> {
-        let filename = PathBuf::from(path.as_ref());
         Ok(self
             .inner
             .read()
             .map_err(|_| Error::RwLockError)?
-            .contains_key(&filename))
+            .contains_key(path.as_ref()))
     }
 
     pub fn check_unsafe_location<P: AsRef<Path>>(
@@ -167,55 +300,104 @@ impl FindUnsafeRs {
         path: P,
         location: LineColumn,
     ) -> Result<Vec<UnsafeLocationKind>, Error> {
-        if !self.already_analyzed(&path)? {
-            self.analyze_file(&path)?;
-        }
-        let filename = PathBuf::from(path.as_ref());
+        self.ensure_analyzed(path.as_ref())?;
         // NOTE(unwrap): entry existed previously or was just inserted
         let lock = self.inner.read().map_err(|_| Error::RwLockError)?;
-        let locations = lock.get(&filename).unwrap();
+        let locations = lock.get(path.as_ref()).unwrap();
         Ok(locations.get_matching(location))
     }
 
+    /// Like `check_unsafe_location`, but only answers whether any location
+    /// matches. Allocates nothing once the file has been analyzed.
     pub fn is_any_unsafe_location<P: AsRef<Path>>(
         &self,
         path: P,
         location: LineColumn,
     ) -> Result<bool, Error> {
-        let kinds = self.check_unsafe_location(path, location)?;
-        Ok(!kinds.is_empty())
+        let filename = path.as_ref();
+        {
+            let lock = self.inner.read().map_err(|_| Error::RwLockError)?;
+            if let Some(locations) = lock.get(filename) {
+                return Ok(locations.is_any_matching(location));
+            }
+        }
+        self.ensure_analyzed(filename)?;
+        // NOTE(unwrap): entry was just inserted
+        let lock = self.inner.read().map_err(|_| Error::RwLockError)?;
+        Ok(lock.get(filename).unwrap().is_any_matching(location))
+    }
+
+    /// Check many locations in the same file at once.
+    ///
+    /// The file is analyzed if necessary and the lock is taken only once
+    /// for all locations, instead of twice per location.
+    pub fn is_any_unsafe_location_batch<P: AsRef<Path>>(
+        &self,
+        path: P,
+        locations: &[LineColumn],
+    ) -> Result<Vec<bool>, Error> {
+        let filename = path.as_ref();
+        {
+            let lock = self.inner.read().map_err(|_| Error::RwLockError)?;
+            if let Some(file_locations) = lock.get(filename) {
+                return Ok(file_locations.is_any_matching_batch(locations));
+            }
+        }
+        self.ensure_analyzed(filename)?;
+        // NOTE(unwrap): entry was just inserted
+        let lock = self.inner.read().map_err(|_| Error::RwLockError)?;
+        Ok(lock.get(filename).unwrap().is_any_matching_batch(locations))
     }
 }
 
 impl UnsafeLocations {
-    fn get_matching(&self, location: LineColumn) -> Vec<UnsafeLocationKind> {
-        std::iter::empty()
-            .chain(
-                self.blocks
-                    .iter()
-                    .filter(|s| s.contains(location))
-                    .map(|_| UnsafeLocationKind::Block),
-            )
-            .chain(
-                self.functions
-                    .iter()
-                    .filter(|(s, _)| s.contains(location))
-                    .map(|(_, name)| UnsafeLocationKind::Function(name.clone())),
-            )
-            .chain(
-                self.traits
-                    .iter()
-                    .filter(|(s, _)| s.contains(location))
-                    .map(|(_, name)| UnsafeLocationKind::Trait(name.clone())),
-            )
-            .chain(
-                self.impls
-                    .iter()
-                    .filter(|s| s.contains(location))
-                    .map(|_| UnsafeLocationKind::Impl),
-            )
+    fn new(mut spans: Vec<(SimpleSpan, UnsafeLocationKind)>) -> Self {
+        spans.sort_by(|(a, _), (b, _)| a.start.cmp(&b.start).then(a.end.cmp(&b.end)));
+        let mut max_end = Vec::with_capacity(spans.len());
+        for (span, _) in &spans {
+            let end = match max_end.last() {
+                Some(&prev) if prev > span.end => prev,
+                _ => span.end,
+            };
+            max_end.push(end);
+        }
+        UnsafeLocations { spans, max_end }
+    }
+
+    /// Number of spans that start at or before location
+    fn candidates(&self, location: LineColumn) -> usize {
+        self.spans
+            .partition_point(|(span, _)| span.start <= location)
+    }
+
+    fn is_any_matching(&self, location: LineColumn) -> bool {
+        match self.candidates(location) {
+            0 => false,
+            n => self.max_end[n - 1] >= location,
+        }
+    }
+
+    fn is_any_matching_batch(&self, locations: &[LineColumn]) -> Vec<bool> {
+        locations
+            .iter()
+            .map(|location| self.is_any_matching(*location))
             .collect()
     }
+
+    fn get_matching(&self, location: LineColumn) -> Vec<UnsafeLocationKind> {
+        // walk the candidates backwards until no earlier span can reach the location
+        let mut matching = Vec::new();
+        for i in (0..self.candidates(location)).rev() {
+            if self.max_end[i] < location {
+                break;
+            }
+            let (span, kind) = &self.spans[i];
+            if span.end >= location {
+                matching.push(kind.clone());
+            }
+        }
+        matching
+    }
 }
 
 // TODO: include information from SimpleSpan
@@ -1,4 +1,4 @@
-use crate::{FindUnsafeRs, Error};
+use crate::{Error, FindUnsafeRs, SimpleSpan, UnsafeLocationKind, UnsafeLocations};
 use proc_macro2::LineColumn;
 
 #[test]
@@ -118,4 +118,173 @@ fn analyze_files() -> Result<(), Error> {
     }
 
     Ok(())
-}
\ No newline at end of file
+}
+
+#[test]
+fn batch_matches_single_queries() -> Result<(), Error> {
+    let f = FindUnsafeRs::new();
+    let path = "test/unsafe-03.rs";
+    let locations = [
+        LineColumn { line: 3, column: 14 },
+        LineColumn { line: 23, column: 13 },
+        LineColumn { line: 11, column: 9 },
+        LineColumn { line: 26, column: 12 },
+        LineColumn { line: 25, column: 22 },
+    ];
+    let batch = f.is_any_unsafe_location_batch(path, &locations)?;
+    assert_eq!(batch, vec![true, false, true, false, true]);
+    for (location, expected) in locations.iter().zip(batch) {
+        assert_eq!(f.is_any_unsafe_location(path, *location)?, expected);
+    }
+    assert!(f.is_any_unsafe_location_batch(path, &[])?.is_empty());
+    match f.is_any_unsafe_location_batch("test/does-not-exist.rs", &locations) {
+        Err(Error::FileError(_)) => { /* ok */ }
+        _ => panic!("expected file error"),
+    }
+    Ok(())
+}
+
+#[test]
+fn check_unsafe_location_kinds() -> Result<(), Error> {
+    let f = FindUnsafeRs::new();
+    let path = "test/unsafe-03.rs";
+    assert_eq!(
+        f.check_unsafe_location(path, LineColumn { line: 25, column: 22 })?,
+        vec![UnsafeLocationKind::Block]
+    );
+    assert_eq!(
+        f.check_unsafe_location(path, LineColumn { line: 18, column: 5 })?,
+        vec![UnsafeLocationKind::Function("foo".to_string())]
+    );
+    assert_eq!(
+        f.check_unsafe_location(path, LineColumn { line: 11, column: 9 })?,
+        vec![UnsafeLocationKind::Impl]
+    );
+    assert_eq!(
+        f.check_unsafe_location(path, LineColumn { line: 4, column: 8 })?,
+        vec![UnsafeLocationKind::Trait("Bar".to_string())]
+    );
+    assert!(f
+        .check_unsafe_location(path, LineColumn { line: 23, column: 13 })?
+        .is_empty());
+    Ok(())
+}
+
+#[test]
+fn span_index_nested_and_disjoint() {
+    let lc = |line, column| LineColumn { line, column };
+    let span = |start, end| SimpleSpan { start, end };
+    // a long span, a span nested in it, and a later disjoint span, inserted unsorted
+    let locations = UnsafeLocations::new(vec![
+        (span(lc(30, 0), lc(32, 1)), UnsafeLocationKind::Impl),
+        (span(lc(12, 4), lc(14, 5)), UnsafeLocationKind::Block),
+        (span(lc(10, 0), lc(20, 1)), UnsafeLocationKind::Function("f".to_string())),
+    ]);
+    assert!(!locations.is_any_matching(lc(9, 100)));
+    assert!(locations.is_any_matching(lc(10, 0)));
+    assert!(locations.is_any_matching(lc(20, 1)));
+    assert!(!locations.is_any_matching(lc(20, 2)));
+    assert!(!locations.is_any_matching(lc(25, 0)));
+    assert!(locations.is_any_matching(lc(31, 7)));
+    assert!(!locations.is_any_matching(lc(40, 0)));
+
+    let mut kinds = locations.get_matching(lc(13, 0));
+    kinds.sort_by_key(|k| format!("{:?}", k));
+    assert_eq!(
+        kinds,
+        vec![
+            UnsafeLocationKind::Block,
+            UnsafeLocationKind::Function("f".to_string())
+        ]
+    );
+    // the nested span ends before the location, the long one does not
+    assert_eq!(
+        locations.get_matching(lc(16, 0)),
+        vec![UnsafeLocationKind::Function("f".to_string())]
+    );
+    assert!(locations.get_matching(lc(25, 0)).is_empty());
+}
+
+#[test]
+fn prepare_files_parallel() -> Result<(), Error> {
+    let f = FindUnsafeRs::new();
+    let paths = [
+        "test/unsafe-01.rs",
+        "test/unsafe-02.rs",
+        "test/does-not-exist.rs",
+        "test/unsafe-03.rs",
+        "test/unsafe-01.rs",
+        "test/unsafe-04.rs",
+    ];
+    let results = f.prepare_files(&paths, 4);
+    assert_eq!(results.len(), paths.len());
+    for (path, result) in paths.iter().zip(&results) {
+        match result {
+            Ok(()) => assert!(f.already_analyzed(path)?),
+            Err(Error::FileError(e)) => {
+                assert_eq!(*path, "test/does-not-exist.rs");
+                assert_eq!(e.kind(), std::io::ErrorKind::NotFound);
+            }
+            Err(_) => panic!("returned wrong error variant"),
+        }
+    }
+    assert!(f.is_any_unsafe_location("test/unsafe-01.rs", LineColumn { line: 7, column: 22 })?);
+    assert!(!f.is_any_unsafe_location("test/unsafe-02.rs", LineColumn { line: 12, column: 13 })?);
+    Ok(())
+}
+
+#[test]
+fn concurrent_queries_same_file() -> Result<(), Error> {
+    let f = FindUnsafeRs::new();
+    let path = "test/unsafe-03.rs";
+    std::thread::scope(|scope| {
+        for _ in 0..8 {
+            scope.spawn(|| {
+                assert!(f
+                    .is_any_unsafe_location(path, LineColumn { line: 25, column: 22 })
+                    .unwrap());
+            });
+        }
+    });
+    assert!(f.pending.lock().unwrap().is_empty());
+    Ok(())
+}
+
+#[test]
+fn cache_roundtrip_and_invalidation() -> Result<(), Error> {
+    let dir = std::env::temp_dir().join(format!("find-unsafe-rs-test-{}", std::process::id()));
+    let _ = std::fs::remove_dir_all(&dir);
+    std::fs::create_dir_all(&dir)?;
+    let cache_dir = dir.join("cache");
+    let src = dir.join("unsafe-03.rs");
+    std::fs::copy("test/unsafe-03.rs", &src)?;
+
+    let inside = LineColumn { line: 25, column: 22 };
+    let outside = LineColumn { line: 20, column: 1 };
+    let cold = FindUnsafeRs::with_cache_dir(&cache_dir);
+    let expected = cold.check_unsafe_location(&src, inside)?;
+    assert!(!expected.is_empty());
+    assert_eq!(std::fs::read_dir(&cache_dir)?.count(), 1);
+
+    let warm = FindUnsafeRs::with_cache_dir(&cache_dir);
+    assert_eq!(warm.check_unsafe_location(&src, inside)?, expected);
+    assert_eq!(
+        warm.is_any_unsafe_location(&src, outside)?,
+        FindUnsafeRs::new().is_any_unsafe_location(&src, outside)?
+    );
+
+    // a changed source file must not be answered from the stale entry
+    std::fs::write(&src, "fn main() {}\n")?;
+    let changed = FindUnsafeRs::with_cache_dir(&cache_dir);
+    assert!(!changed.is_any_unsafe_location(&src, inside)?);
+
+    // a corrupt entry is a miss
+    for entry in std::fs::read_dir(&cache_dir)? {
+        std::fs::write(entry?.path(), b"FURC")?;
+    }
+    let corrupt = FindUnsafeRs::with_cache_dir(&cache_dir);
+    assert!(!corrupt.is_any_unsafe_location(&src, inside)?);
+
+    std::fs::remove_dir_all(&dir)?;
+    Ok(())
+}
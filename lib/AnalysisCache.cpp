@@ -0,0 +1,191 @@
+#include "AnalysisCache.h"
+#include "ConcurrentHelperAnalyses.h"
+#include "Instrumentation.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SHA1.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+namespace psr
+{
+
+    namespace
+    {
+
+        // bump whenever the layout or the meaning of a cache entry changes
+        constexpr llvm::StringLiteral CacheFormatVersion = "unsafe-rs-analysis-cache-v1";
+
+        constexpr llvm::StringLiteral ModuleFileName = "module.bc";
+        constexpr llvm::StringLiteral PTSFileName = "pts.json";
+        constexpr llvm::StringLiteral CGFileName = "cg.json";
+
+        std::optional<nlohmann::json> read_json(const std::filesystem::path &Path)
+        {
+            std::ifstream in(Path);
+            if (!in)
+            {
+                return std::nullopt;
+            }
+            auto json = nlohmann::json::parse(in, nullptr, /* allow_exceptions */ false);
+            if (json.is_discarded())
+            {
+                return std::nullopt;
+            }
+            return json;
+        }
+
+        bool write_json(const std::filesystem::path &Path, const nlohmann::json &Json)
+        {
+            std::ofstream out(Path);
+            out << Json;
+            return out.good();
+        }
+
+        std::unique_ptr<HelperAnalyses> load_entry(const std::filesystem::path &Entry,
+                                                   const std::vector<std::string> &EntryPoints)
+        {
+            const auto module_path = Entry / ModuleFileName.str();
+            if (!std::filesystem::exists(module_path))
+            {
+                return nullptr;
+            }
+            auto pts = read_json(Entry / PTSFileName.str());
+            auto cg = read_json(Entry / CGFileName.str());
+            if (!pts || !cg)
+            {
+                PHASAR_LOG_LEVEL(WARNING, "analysis cache: ignoring incomplete entry " << Entry.string());
+                return nullptr;
+            }
+            auto phase = Instrumentation::global().phase("load_cache_entry");
+            HelperAnalysisConfig config;
+            config.PrecomputedPTS = std::move(pts);
+            config.PrecomputedCG = std::move(cg);
+            // functions that were not reachable when the entry was written are still analyzed on demand
+            config.AllowLazyPTS = true;
+            auto HA = std::make_unique<HelperAnalyses>(module_path.string(), EntryPoints, std::move(config));
+            HA->getICFG();
+            return HA;
+        }
+
+        // the IR is parsed when the helper analyses are created, the call graph is built on first access
+        std::unique_ptr<HelperAnalyses> build_helper_analyses(const std::string &IRFile,
+                                                              const std::vector<std::string> &EntryPoints)
+        {
+            std::unique_ptr<HelperAnalyses> HA;
+            {
+                auto phase = Instrumentation::global().phase("load_ir");
+                HA = std::make_unique<HelperAnalyses>(IRFile, EntryPoints);
+            }
+            {
+                auto phase = Instrumentation::global().phase("call_graph");
+                HA->getICFG();
+            }
+            return HA;
+        }
+
+        bool store_entry(HelperAnalyses &HA, const std::filesystem::path &Entry)
+        {
+            std::error_code ec;
+            const auto tmp = Entry.parent_path() / (Entry.filename().string() + ".tmp." + std::to_string(getpid()));
+            std::filesystem::remove_all(tmp, ec);
+            if (!std::filesystem::create_directories(tmp, ec))
+            {
+                return false;
+            }
+
+            // the module is stored after PhASAR has annotated it, so the value ids
+            // used in the serialized call graph and points-to sets stay valid on reload
+            bool ok = true;
+            {
+                llvm::raw_fd_ostream out((tmp / ModuleFileName.str()).string(), ec);
+                if (ec)
+                {
+                    ok = false;
+                }
+                else
+                {
+                    llvm::WriteBitcodeToFile(*HA.getProjectIRDB().getModule(), out);
+                }
+            }
+            ok = ok && write_json(tmp / CGFileName.str(), HA.getICFG().getAsJson());
+            ok = ok && write_json(tmp / PTSFileName.str(), HA.getAliasInfo().getAsJson());
+
+            // another run may have stored the same entry in the meantime, keep the first one
+            if (ok)
+            {
+                std::filesystem::rename(tmp, Entry, ec);
+            }
+            if (!ok || ec)
+            {
+                std::filesystem::remove_all(tmp, ec);
+                return ok && std::filesystem::exists(Entry / ModuleFileName.str());
+            }
+            return true;
+        }
+
+    } // anonymous namespace
+
+    std::string analysis_cache_key(const std::string &IRFile, const std::vector<std::string> &EntryPoints)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(IRFile);
+        if (!buffer)
+        {
+            return "";
+        }
+        llvm::SHA1 hasher;
+        hasher.update(CacheFormatVersion);
+        hasher.update((*buffer)->getBuffer());
+        for (const auto &entry_point : EntryPoints)
+        {
+            // separator, so that entry point lists cannot collide by concatenation
+            hasher.update(llvm::StringRef("\0", 1));
+            hasher.update(entry_point);
+        }
+        return llvm::toHex(hasher.final(), /* LowerCase */ true);
+    }
+
+    std::unique_ptr<HelperAnalyses> load_helper_analyses(const std::string &IRFile,
+                                                         const std::vector<std::string> &EntryPoints,
+                                                         const std::string &CacheDir)
+    {
+        if (CacheDir.empty())
+        {
+            return build_helper_analyses(IRFile, EntryPoints);
+        }
+
+        const auto key = analysis_cache_key(IRFile, EntryPoints);
+        if (key.empty())
+        {
+            PHASAR_LOG_LEVEL(WARNING, "analysis cache: could not read " << IRFile << ", cache disabled");
+            return build_helper_analyses(IRFile, EntryPoints);
+        }
+        const auto entry = std::filesystem::path(CacheDir) / key;
+
+        if (auto HA = load_entry(entry, EntryPoints))
+        {
+            PHASAR_LOG_LEVEL(INFO, "analysis cache: hit " << entry.string());
+            return HA;
+        }
+
+        PHASAR_LOG_LEVEL(INFO, "analysis cache: miss " << entry.string());
+        auto HA = build_helper_analyses(IRFile, EntryPoints);
+        {
+            // the alias sets are computed lazily, compute all of them so the entry is complete
+            auto phase = Instrumentation::global().phase("points_to");
+            prepare_for_concurrent_reads(*HA);
+        }
+        auto phase = Instrumentation::global().phase("cache_store");
+        if (!store_entry(*HA, entry))
+        {
+            PHASAR_LOG_LEVEL(WARNING, "analysis cache: could not store " << entry.string());
+        }
+        return HA;
+    }
+
+} // namespace psr
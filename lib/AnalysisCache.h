@@ -0,0 +1,41 @@
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include "phasar.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Key of an IR file in the analysis cache: the hex SHA1 of the file
+     * contents, the entry points and the cache format version.
+     * Returns an empty string if the file cannot be read.
+     */
+    std::string analysis_cache_key(const std::string &IRFile, const std::vector<std::string> &EntryPoints);
+
+    /**
+     * Create the HelperAnalyses for IRFile, optionally backed by an on-disk cache.
+     *
+     * With an empty CacheDir this is the same as `HelperAnalyses(IRFile, EntryPoints)`,
+     * followed by building the call graph, each in its own Instrumentation phase.
+     * Otherwise the cache entry <CacheDir>/<key>/ is used if present: it holds the
+     * module as annotated by PhASAR in bitcode (module.bc), the serialized points-to
+     * sets (pts.json) and the serialized call graph (cg.json), so a warm run only
+     * loads bitcode and skips the textual IR parser, the call graph construction
+     * and the alias analysis.
+     * On a miss, the helper analyses are built as usual, all alias sets are computed
+     * up front (see prepare_for_concurrent_reads) and the entry is written. Entries
+     * are written to a temporary directory and renamed into place, so concurrent
+     * runs on the same file never see a partial entry.
+     */
+    std::unique_ptr<HelperAnalyses> load_helper_analyses(const std::string &IRFile,
+                                                         const std::vector<std::string> &EntryPoints,
+                                                         const std::string &CacheDir);
+
+} // namespace psr
+
+#endif // ANALYSIS_CACHE_H
@@ -0,0 +1,72 @@
+#include "ConcurrentHelperAnalyses.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+
+namespace psr
+{
+
+    void prepare_for_concurrent_reads(HelperAnalyses &HA)
+    {
+        auto &IRDB = HA.getProjectIRDB();
+        // the ICFG is built on first access, together with the call graph
+        HA.getICFG();
+
+        auto &AS = HA.getAliasInfo();
+        llvm::DenseSet<const llvm::Value *> queried;
+        llvm::SmallVector<const llvm::Value *, 16> worklist;
+        // V and, for a constant, everything it is built from, e.g. the global of a getelementptr or bitcast expression
+        auto query = [&](const llvm::Value *V)
+        {
+            worklist.push_back(V);
+            while (!worklist.empty())
+            {
+                const auto *value = worklist.pop_back_val();
+                if (!queried.insert(value).second)
+                {
+                    continue;
+                }
+                if (value->getType()->isPointerTy())
+                {
+                    AS.getAliasSet(value);
+                }
+                if (const auto *constant = llvm::dyn_cast<llvm::Constant>(value);
+                    constant && !llvm::isa<llvm::GlobalValue>(constant))
+                {
+                    for (const auto &op : constant->operands())
+                    {
+                        worklist.push_back(op.get());
+                    }
+                }
+            }
+        };
+
+        const auto &M = *IRDB.getModule();
+        for (const auto &G : M.globals())
+        {
+            query(&G);
+            if (G.hasInitializer())
+            {
+                query(G.getInitializer());
+            }
+        }
+        for (const auto &F : M)
+        {
+            query(&F);
+            for (const auto &Arg : F.args())
+            {
+                query(&Arg);
+            }
+        }
+        for (const auto *I : IRDB.getAllInstructions())
+        {
+            query(I);
+            for (const auto &op : I->operands())
+            {
+                query(op.get());
+            }
+        }
+    }
+
+} // namespace psr
@@ -0,0 +1,26 @@
+#ifndef CONCURRENT_HELPER_ANALYSES_H
+#define CONCURRENT_HELPER_ANALYSES_H
+
+#include "phasar.h"
+
+namespace psr
+{
+
+    /**
+     * Prepare a HelperAnalyses instance to be shared by several solvers running
+     * on different threads.
+     *
+     * HelperAnalyses builds the IRDB, ICFG and alias information lazily on first
+     * access, and the alias sets are computed per function on first query and
+     * then cached. Both would be data races when two solvers query them at the
+     * same time. This forces all of them to be built up front and queries the
+     * alias set of every pointer value once: globals, functions, arguments,
+     * instructions and every operand of an instruction, including constants and
+     * the values a constant expression is built from. Afterwards the solvers
+     * only perform lookups of already computed results.
+     */
+    void prepare_for_concurrent_reads(HelperAnalyses &HA);
+
+} // namespace psr
+
+#endif // CONCURRENT_HELPER_ANALYSES_H
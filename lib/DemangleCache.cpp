@@ -0,0 +1,67 @@
+#include "DemangleCache.h"
+
+#include "llvm/Demangle/Demangle.h"
+
+namespace psr
+{
+
+    DemangleCache &DemangleCache::global()
+    {
+        static DemangleCache Cache;
+        return Cache;
+    }
+
+    llvm::StringRef DemangleCache::demangleLocked(llvm::StringRef Name)
+    {
+        // llvm::demangle returns anything it does not recognize unchanged, so skip the copy for those
+        if (!Name.startswith("_Z") && !Name.startswith("_R"))
+        {
+            return Name;
+        }
+        auto it = ByMangled.find(Name);
+        if (it != ByMangled.end())
+        {
+            return it->second;
+        }
+        const auto mangled = Names.save(Name);
+        const auto demangled = Names.save(llvm::demangle(mangled.str()));
+        ByMangled.try_emplace(mangled, demangled);
+        return demangled;
+    }
+
+    llvm::StringRef DemangleCache::demangle(llvm::StringRef Name)
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        return demangleLocked(Name);
+    }
+
+    llvm::StringRef DemangleCache::demangle(const llvm::Function *F)
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        auto it = ByFunction.find(F);
+        if (it != ByFunction.end())
+        {
+            return it->second;
+        }
+        // not mangled names point into the IR, save them so they outlive the module
+        const auto demangled = Names.save(demangleLocked(F->getName()));
+        ByFunction.try_emplace(F, demangled);
+        ByDemangled.try_emplace(demangled, F);
+        return demangled;
+    }
+
+    void DemangleCache::addModule(const llvm::Module &M)
+    {
+        for (const auto &F : M)
+        {
+            (void)demangle(&F);
+        }
+    }
+
+    const llvm::Function *DemangleCache::lookup(llvm::StringRef Demangled) const
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        return ByDemangled.lookup(Demangled);
+    }
+
+} // namespace psr
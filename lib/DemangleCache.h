@@ -0,0 +1,59 @@
+#ifndef DEMANGLE_CACHE_H
+#define DEMANGLE_CACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+
+#include <mutex>
+
+namespace psr
+{
+
+    /**
+     * Process-wide cache of demangled function names.
+     *
+     * Names are demangled with llvm::demangle, the same demangler PhASAR uses
+     * for the names it passes to a TypeStateDescription, so those names can be
+     * mapped back to their llvm::Function. Every demangled name is stored once
+     * in an arena and returned as a StringRef into it, which stays valid for the
+     * lifetime of the process. Names that are not mangled (no "_Z" or "_R"
+     * prefix) are returned as they are, without copying or demangling them.
+     *
+     * All members are safe to call from several threads.
+     */
+    class DemangleCache
+    {
+    private:
+        mutable std::mutex Mutex;
+        llvm::BumpPtrAllocator Arena;
+        llvm::UniqueStringSaver Names{Arena};
+        // keys point into the arena (or into the names of the IR)
+        llvm::DenseMap<llvm::StringRef, llvm::StringRef> ByMangled;
+        llvm::DenseMap<const llvm::Function *, llvm::StringRef> ByFunction;
+        llvm::DenseMap<llvm::StringRef, const llvm::Function *> ByDemangled;
+
+        llvm::StringRef demangleLocked(llvm::StringRef Name);
+
+    public:
+        static DemangleCache &global();
+
+        // demangled Name, or Name itself if it is not mangled
+        [[nodiscard]] llvm::StringRef demangle(llvm::StringRef Name);
+
+        // demangled name of F, F can then be found by lookup
+        [[nodiscard]] llvm::StringRef demangle(const llvm::Function *F);
+
+        // add all functions of M, so they can be found by lookup
+        void addModule(const llvm::Module &M);
+
+        // the function with the demangled name, the first one added if there are several, nullptr if none was added
+        [[nodiscard]] const llvm::Function *lookup(llvm::StringRef Demangled) const;
+    }; // class DemangleCache
+
+} // namespace psr
+
+#endif // DEMANGLE_CACHE_H
@@ -0,0 +1,137 @@
+#include "DoubleLeaks.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/InstrTypes.h"
+
+#include <numeric>
+
+namespace psr
+{
+
+    namespace
+    {
+        struct LeakedValue
+        {
+            const llvm::Value *Value;
+            llvm::SmallVector<const llvm::Instruction *, 2> Sinks;
+        };
+
+        unsigned find_root(std::vector<unsigned> &Parent, unsigned Idx)
+        {
+            while (Parent[Idx] != Idx)
+            {
+                // path halving
+                Parent[Idx] = Parent[Parent[Idx]];
+                Idx = Parent[Idx];
+            }
+            return Idx;
+        }
+    } // anonymous namespace
+
+    std::vector<DoubleLeak> find_double_leaks(const XTaint::LeakMap_t &Leaks, LLVMAliasSet *AliasInfo)
+    {
+        // value -> sinks, in one pass over the leaks
+        std::vector<LeakedValue> leaked;
+        llvm::DenseMap<const llvm::Value *, unsigned> leaked_ids;
+        for (const auto &[sink, values] : Leaks)
+        {
+            for (const auto *value : values)
+            {
+                const auto [it, inserted] = leaked_ids.try_emplace(value, leaked.size());
+                if (inserted)
+                {
+                    leaked.push_back(LeakedValue{value, {}});
+                }
+                leaked[it->second].Sinks.push_back(sink);
+            }
+        }
+
+        // alias classes of the leaked values, all members of an alias class share one alias set
+        std::vector<unsigned> parent(leaked.size());
+        std::iota(parent.begin(), parent.end(), 0);
+        if (AliasInfo)
+        {
+            llvm::DenseMap<const void *, unsigned> class_of_set;
+            for (unsigned idx = 0; idx < leaked.size(); ++idx)
+            {
+                if (!leaked[idx].Value->getType()->isPointerTy())
+                {
+                    continue;
+                }
+                const auto alias_set = AliasInfo->getAliasSet(leaked[idx].Value);
+                if (!alias_set)
+                {
+                    continue;
+                }
+                const auto [it, inserted] = class_of_set.try_emplace(&*alias_set, idx);
+                if (!inserted)
+                {
+                    parent[find_root(parent, idx)] = find_root(parent, it->second);
+                }
+            }
+        }
+
+        // one entry per class, in the order of the first leaked value of the class
+        std::vector<DoubleLeak> classes;
+        llvm::DenseMap<unsigned, unsigned> class_ids;
+        llvm::DenseSet<std::pair<unsigned, const llvm::Instruction *>> class_sinks;
+        for (unsigned idx = 0; idx < leaked.size(); ++idx)
+        {
+            const auto [it, inserted] = class_ids.try_emplace(find_root(parent, idx), classes.size());
+            if (inserted)
+            {
+                classes.emplace_back();
+            }
+            auto &leak = classes[it->second];
+            leak.Values.push_back(leaked[idx].Value);
+            for (const auto *sink : leaked[idx].Sinks)
+            {
+                if (class_sinks.insert({it->second, sink}).second)
+                {
+                    leak.Sinks.push_back(sink);
+                }
+            }
+        }
+
+        std::vector<DoubleLeak> double_leaks;
+        for (auto &leak : classes)
+        {
+            if (leak.Sinks.size() >= 2)
+            {
+                double_leaks.push_back(std::move(leak));
+            }
+        }
+        return double_leaks;
+    }
+
+    void print_double_leaks(llvm::ArrayRef<DoubleLeak> DoubleLeaks, llvm::raw_ostream &OS)
+    {
+        for (const auto &leak : DoubleLeaks)
+        {
+            if (leak.Values.size() == 1)
+            {
+                OS << "Value: " << *leak.Values.front() << "\n";
+            }
+            else
+            {
+                OS << "Aliasing values:\n";
+                for (const auto *value : leak.Values)
+                {
+                    OS << " -> " << *value << "\n";
+                }
+            }
+            OS << "is leaked multiple times by instructions: \n";
+            for (const auto *instr : leak.Sinks)
+            {
+                OS << " -> " << *instr << " ( Opcode = " << instr->getOpcodeName() << " ) \n";
+                if (const auto *cb = llvm::dyn_cast<llvm::CallBase>(instr); cb && cb->getCalledFunction())
+                {
+                    OS << *cb << " => called function: " << cb->getCalledFunction()->getName() << "\n";
+                }
+            }
+            OS << "\n";
+        }
+    }
+
+} // namespace psr
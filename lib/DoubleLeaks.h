@@ -0,0 +1,40 @@
+#ifndef DOUBLE_LEAKS_H
+#define DOUBLE_LEAKS_H
+
+#include "phasar.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Leaked values of one alias class that reach more than one sink.
+     */
+    struct DoubleLeak
+    {
+        // the leaked values of the class, in the order they were first seen
+        llvm::SmallVector<const llvm::Value *, 2> Values;
+        // the distinct sinks any of them reaches, in the order they were first seen
+        llvm::SmallVector<const llvm::Instruction *, 2> Sinks;
+    };
+
+    /**
+     * Find the values that are leaked by at least two different instructions.
+     *
+     * The leaks are inverted into a value -> sinks index in one pass. With
+     * AliasInfo, leaked pointers that share an alias set are grouped into one
+     * class first, so dropping two aliasing pointers is reported as well.
+     * Without it, every value is its own class.
+     */
+    std::vector<DoubleLeak> find_double_leaks(const XTaint::LeakMap_t &Leaks, LLVMAliasSet *AliasInfo = nullptr);
+
+    void print_double_leaks(llvm::ArrayRef<DoubleLeak> DoubleLeaks, llvm::raw_ostream &OS);
+
+} // namespace psr
+
+#endif // DOUBLE_LEAKS_H
@@ -0,0 +1,115 @@
+#include "FunctionFingerprint.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <string>
+
+namespace psr
+{
+
+    uint64_t function_fingerprint(const llvm::Function &F)
+    {
+        std::string canonical;
+        llvm::raw_string_ostream OS(canonical);
+
+        F.getFunctionType()->print(OS);
+        const auto attrs = F.getAttributes();
+        for (unsigned i = 0; i < F.arg_size(); ++i)
+        {
+            OS << "|" << attrs.getParamAttrs(i).getAsString();
+        }
+        OS << "\n";
+
+        // local values are numbered before printing, so forward references get the same number
+        llvm::DenseMap<const llvm::Value *, unsigned> local_ids;
+        for (const auto &arg : F.args())
+        {
+            local_ids.try_emplace(&arg, local_ids.size());
+        }
+        for (const auto &BB : F)
+        {
+            local_ids.try_emplace(&BB, local_ids.size());
+            for (const auto &I : BB)
+            {
+                if (!llvm::isa<llvm::DbgInfoIntrinsic>(I))
+                {
+                    local_ids.try_emplace(&I, local_ids.size());
+                }
+            }
+        }
+
+        for (const auto &BB : F)
+        {
+            OS << "bb" << local_ids[&BB] << ":\n";
+            for (const auto &I : BB)
+            {
+                if (llvm::isa<llvm::DbgInfoIntrinsic>(I))
+                {
+                    continue;
+                }
+                OS << I.getOpcodeName() << " ";
+                I.getType()->print(OS);
+                if (const auto *cmp = llvm::dyn_cast<llvm::CmpInst>(&I))
+                {
+                    OS << " " << llvm::CmpInst::getPredicateName(cmp->getPredicate());
+                }
+                else if (const auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(&I))
+                {
+                    OS << " ";
+                    alloca->getAllocatedType()->print(OS);
+                }
+                else if (const auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(&I))
+                {
+                    OS << " ";
+                    gep->getSourceElementType()->print(OS);
+                }
+                for (const auto &op : I.operands())
+                {
+                    OS << ", ";
+                    const llvm::Value *V = op.get();
+                    if (auto it = local_ids.find(V); it != local_ids.end())
+                    {
+                        OS << "%" << it->second;
+                    }
+                    else if (const auto *G = llvm::dyn_cast<llvm::GlobalValue>(V))
+                    {
+                        // the type of callees and other globals, so a changed declaration changes its users
+                        OS << "@" << G->getName() << ":";
+                        G->getValueType()->print(OS);
+                    }
+                    else if (llvm::isa<llvm::Constant>(V))
+                    {
+                        V->printAsOperand(OS, /* PrintType */ true);
+                    }
+                    // metadata operands are debug info only
+                }
+                OS << "\n";
+            }
+        }
+
+        return llvm::xxHash64(OS.str());
+    }
+
+    std::vector<const llvm::Instruction *> fingerprinted_instructions(const llvm::Function &F)
+    {
+        std::vector<const llvm::Instruction *> insts;
+        for (const auto &BB : F)
+        {
+            for (const auto &I : BB)
+            {
+                if (!llvm::isa<llvm::DbgInfoIntrinsic>(I))
+                {
+                    insts.push_back(&I);
+                }
+            }
+        }
+        return insts;
+    }
+
+} // namespace psr
@@ -0,0 +1,34 @@
+#ifndef FUNCTION_FINGERPRINT_H
+#define FUNCTION_FINGERPRINT_H
+
+#include "llvm/IR/Function.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Fingerprint of the IR of a function that is stable across compilations.
+     *
+     * Covers the signature with its parameter attributes and every instruction
+     * with opcode, type and operands. Local values are numbered in order of
+     * appearance, globals are referred to by name, so renumbering of unrelated
+     * values in the module does not change the fingerprint. The types of
+     * referenced globals are included, so a caller changes with the signature of
+     * a callee. Debug info is ignored, a function that only moved in the source
+     * file keeps its fingerprint.
+     */
+    [[nodiscard]] uint64_t function_fingerprint(const llvm::Function &F);
+
+    /**
+     * The instructions of F covered by function_fingerprint, i.e. all but the
+     * debug intrinsics, in order. Positions in this list stay valid for every
+     * function with the same fingerprint.
+     */
+    [[nodiscard]] std::vector<const llvm::Instruction *> fingerprinted_instructions(const llvm::Function &F);
+
+} // namespace psr
+
+#endif // FUNCTION_FINGERPRINT_H
@@ -0,0 +1,195 @@
+#include "Instrumentation.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace psr
+{
+
+    namespace
+    {
+        double to_ms(const struct timeval &tv)
+        {
+            return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+        }
+
+        double elapsed_ms(std::chrono::steady_clock::time_point Since)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Since).count();
+        }
+
+        void write_summary_at_exit()
+        {
+            Instrumentation::global().writeSummary(/* Complete */ true);
+        }
+    } // anonymous namespace
+
+    double process_cpu_ms()
+    {
+        struct rusage ru = {};
+        getrusage(RUSAGE_SELF, &ru);
+        return to_ms(ru.ru_utime) + to_ms(ru.ru_stime);
+    }
+
+    long current_rss_kb()
+    {
+        // the second field of statm is the number of resident pages
+        std::ifstream statm("/proc/self/statm");
+        long size = 0;
+        long resident = 0;
+        if (!(statm >> size >> resident))
+        {
+            return 0;
+        }
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    long peak_rss_kb()
+    {
+        struct rusage ru = {};
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss;
+    }
+
+    Instrumentation::Phase::Phase(Instrumentation &Owner, std::string Name)
+        : Owner(&Owner), Start(std::chrono::steady_clock::now()), CpuStartMs(process_cpu_ms())
+    {
+        Record.Name = std::move(Name);
+        Record.RssStartKb = current_rss_kb();
+        std::lock_guard<std::mutex> lock(Owner.Mutex);
+        Owner.OpenPhases.push_back(Record.Name);
+        Owner.writeSummaryLocked(false);
+    }
+
+    Instrumentation::Phase::~Phase()
+    {
+        Record.WallMs = elapsed_ms(Start);
+        Record.CpuMs = process_cpu_ms() - CpuStartMs;
+        Record.RssEndKb = current_rss_kb();
+        Record.PeakRssKb = peak_rss_kb();
+        std::lock_guard<std::mutex> lock(Owner->Mutex);
+        auto it = std::find(Owner->OpenPhases.begin(), Owner->OpenPhases.end(), Record.Name);
+        if (it != Owner->OpenPhases.end())
+        {
+            Owner->OpenPhases.erase(it);
+        }
+        Owner->Phases.push_back(std::move(Record));
+        Owner->writeSummaryLocked(false);
+    }
+
+    Instrumentation &Instrumentation::global()
+    {
+        static Instrumentation Instance;
+        return Instance;
+    }
+
+    void Instrumentation::enableSummary(std::string Tool, std::string Path)
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        const bool first = SummaryFile.empty();
+        this->Tool = std::move(Tool);
+        SummaryFile = std::move(Path);
+        if (first)
+        {
+            // registered after global() constructed the instance, so it runs before the instance is destroyed
+            std::atexit(write_summary_at_exit);
+        }
+    }
+
+    bool Instrumentation::enabled() const
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        return !SummaryFile.empty();
+    }
+
+    void Instrumentation::addCounter(llvm::StringRef Name, uint64_t Delta)
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Counters[Name.str()] += Delta;
+    }
+
+    void Instrumentation::setCounter(llvm::StringRef Name, uint64_t Value)
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Counters[Name.str()] = Value;
+    }
+
+    void Instrumentation::writeJson(llvm::raw_ostream &OS, bool Complete) const
+    {
+        llvm::json::OStream J(OS, /* IndentSize */ 2);
+        J.object([&]
+                 {
+                     J.attribute("tool", Tool);
+                     J.attribute("complete", Complete);
+                     J.attribute("wall_ms", elapsed_ms(Start));
+                     J.attribute("cpu_ms", process_cpu_ms());
+                     J.attribute("rss_kb", static_cast<int64_t>(current_rss_kb()));
+                     J.attribute("peak_rss_kb", static_cast<int64_t>(peak_rss_kb()));
+                     J.attributeArray("phases", [&]
+                                      {
+                                          for (const auto &P : Phases)
+                                          {
+                                              J.object([&]
+                                                       {
+                                                           J.attribute("name", P.Name);
+                                                           J.attribute("wall_ms", P.WallMs);
+                                                           J.attribute("cpu_ms", P.CpuMs);
+                                                           J.attribute("rss_start_kb", static_cast<int64_t>(P.RssStartKb));
+                                                           J.attribute("rss_end_kb", static_cast<int64_t>(P.RssEndKb));
+                                                           J.attribute("peak_rss_kb", static_cast<int64_t>(P.PeakRssKb)); });
+                                          } });
+                     J.attributeArray("open_phases", [&]
+                                      {
+                                          for (const auto &Name : OpenPhases)
+                                          {
+                                              J.value(Name);
+                                          } });
+                     J.attributeObject("counters", [&]
+                                       {
+                                           for (const auto &[Name, Value] : Counters)
+                                           {
+                                               J.attribute(Name, static_cast<int64_t>(Value));
+                                           } }); });
+        OS << "\n";
+    }
+
+    void Instrumentation::writeSummaryLocked(bool Complete) const
+    {
+        if (SummaryFile.empty() || (SummaryFile == "-" && !Complete))
+        {
+            return;
+        }
+        if (SummaryFile == "-")
+        {
+            writeJson(llvm::outs(), Complete);
+            llvm::outs().flush();
+            return;
+        }
+        // written to a temporary file and renamed, so a run killed while writing leaves the previous summary
+        const auto tmp = SummaryFile + ".tmp." + std::to_string(getpid());
+        {
+            std::error_code ec;
+            llvm::raw_fd_ostream out(tmp, ec);
+            if (ec)
+            {
+                return;
+            }
+            writeJson(out, Complete);
+        }
+        llvm::sys::fs::rename(tmp, SummaryFile);
+    }
+
+    void Instrumentation::writeSummary(bool Complete) const
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        writeSummaryLocked(Complete);
+    }
+
+} // namespace psr
@@ -0,0 +1,106 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Process-wide record of the phases and counters of a tool run.
+     *
+     * A phase records its wall time, the CPU time of the process, the resident
+     * set size at its start and end and the peak resident set size of the process
+     * at its end. CPU time and peak RSS are process-wide, so phases that run
+     * concurrently are each charged for the other ones as well.
+     *
+     * Once a summary file is set, the JSON summary is rewritten whenever a
+     * phase starts or ends and once more at exit. A run that is killed on its
+     * memory or time limit therefore leaves a summary with "complete": false
+     * that lists the phases that were still open.
+     *
+     * All members are safe to call from several threads.
+     */
+    class Instrumentation
+    {
+    public:
+        struct PhaseRecord
+        {
+            std::string Name;
+            double WallMs = 0;
+            double CpuMs = 0;
+            long RssStartKb = 0;
+            long RssEndKb = 0;
+            long PeakRssKb = 0;
+        };
+
+        /**
+         * A phase that ends when this object is destroyed.
+         */
+        class Phase
+        {
+        private:
+            Instrumentation *Owner;
+            PhaseRecord Record;
+            std::chrono::steady_clock::time_point Start;
+            double CpuStartMs;
+
+        public:
+            Phase(Instrumentation &Owner, std::string Name);
+            ~Phase();
+            Phase(const Phase &) = delete;
+            Phase &operator=(const Phase &) = delete;
+        }; // class Phase
+
+    private:
+        mutable std::mutex Mutex;
+        std::string Tool;
+        std::string SummaryFile;
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        // in the order the phases ended
+        std::vector<PhaseRecord> Phases;
+        // phases that started but did not end yet, a name may be open several times
+        std::vector<std::string> OpenPhases;
+        std::map<std::string, uint64_t> Counters;
+
+        void writeSummaryLocked(bool Complete) const;
+
+    public:
+        static Instrumentation &global();
+
+        // write the summary of Tool to Path after every phase and at exit, "-" writes it to stdout at exit only
+        void enableSummary(std::string Tool, std::string Path);
+
+        [[nodiscard]] bool enabled() const;
+
+        [[nodiscard]] Phase phase(std::string Name) { return Phase(*this, std::move(Name)); }
+
+        void addCounter(llvm::StringRef Name, uint64_t Delta = 1);
+        void setCounter(llvm::StringRef Name, uint64_t Value);
+
+        // the summary as a single JSON object
+        void writeJson(llvm::raw_ostream &OS, bool Complete) const;
+
+        void writeSummary(bool Complete) const;
+    }; // class Instrumentation
+
+    // CPU time of the process in ms, user and system
+    double process_cpu_ms();
+
+    // current resident set size of the process in KiB, 0 if unknown
+    long current_rss_kb();
+
+    // peak resident set size of the process in KiB
+    long peak_rss_kb();
+
+} // namespace psr
+
+#endif // INSTRUMENTATION_H
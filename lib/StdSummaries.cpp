@@ -0,0 +1,178 @@
+#include "StdSummaries.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+
+#include <cctype>
+
+namespace psr
+{
+
+    namespace
+    {
+        bool is_ident_char(char C)
+        {
+            return std::isalnum(static_cast<unsigned char>(C)) || C == '_';
+        }
+
+        // the index after the bracket closing the one at Open, or the end of S if it is not closed
+        size_t skip_brackets(llvm::StringRef S, size_t Open, char OpenC, char CloseC)
+        {
+            unsigned depth = 0;
+            for (size_t i = Open; i < S.size(); ++i)
+            {
+                if (S[i] == OpenC)
+                {
+                    ++depth;
+                }
+                // the '>' of a "->" in a fn type does not close anything
+                else if (S[i] == CloseC && !(CloseC == '>' && i > 0 && S[i - 1] == '-') && --depth == 0)
+                {
+                    return i + 1;
+                }
+            }
+            return S.size();
+        }
+
+        // the index of the first Needle in S outside of any brackets, npos if there is none
+        size_t find_top_level(llvm::StringRef S, llvm::StringRef Needle)
+        {
+            unsigned depth = 0;
+            for (size_t i = 0; i < S.size(); ++i)
+            {
+                const char c = S[i];
+                if (c == '<' || c == '[' || c == '(' || c == '{')
+                {
+                    ++depth;
+                }
+                else if ((c == '>' && !(i > 0 && S[i - 1] == '-')) || c == ']' || c == ')' || c == '}')
+                {
+                    depth -= depth > 0;
+                }
+                else if (depth == 0 && S.substr(i).startswith(Needle))
+                {
+                    return i;
+                }
+            }
+            return llvm::StringRef::npos;
+        }
+
+        // true if the first path segment of Path, without a crate disambiguator, is one of Roots
+        bool is_crate_root(llvm::StringRef Path, const llvm::StringSet<> &Roots)
+        {
+            return Roots.contains(Path.take_while(is_ident_char));
+        }
+
+        using S = StdSummary;
+        using K = StdFnKind;
+
+        const llvm::StringMap<StdSummary> &std_summaries()
+        {
+            // keyed by erase_generics of the demangled path,
+            // functions that may return through an sret argument list it as parameter 0 as well
+            static const llvm::StringMap<StdSummary> Summaries = {
+                {"<alloc::boxed::Box<_>>::into_raw", S{K::RAW_PTR_OUT, {}, {0}}},
+                {"<alloc::boxed::Box<_>>::from_raw", S{K::RAW_PTR_IN, {0}, {0}}},
+                {"<alloc::vec::Vec<_>>::as_mut_ptr", S{K::RAW_PTR_OUT, {}, {0}}},
+                {"<alloc::vec::Vec<_>>::as_ptr", S{K::RAW_PTR_OUT, {}, {0}}},
+                {"<alloc::vec::Vec<_>>::into_raw_parts", S{K::RAW_PTR_OUT, {}, {0, 1}}},
+                {"<alloc::vec::Vec<_>>::from_raw_parts", S{K::RAW_PTR_IN, {0, 1}, {0, 1}}},
+                {"<alloc::string::String>::from_raw_parts", S{K::RAW_PTR_IN, {0, 1}, {0, 1}}},
+                {"<str>::as_mut_ptr", S{K::RAW_PTR_OUT, {}, {0}}},
+                {"<str>::as_ptr", S{K::RAW_PTR_OUT, {}, {0}}},
+                {"<[_]>::as_mut_ptr", S{K::RAW_PTR_OUT, {}, {0}}},
+                {"<[_]>::as_ptr", S{K::RAW_PTR_OUT, {}, {0}}},
+                {"core::slice::raw::from_raw_parts::<_>", S{K::RAW_PTR_IN, {0}, {0}}},
+                {"core::slice::raw::from_raw_parts_mut::<_>", S{K::RAW_PTR_IN, {0}, {0}}},
+                {"<alloc::raw_vec::RawVec<_> as core::ops::drop::Drop>::drop", S{K::DROP, {0}, {}}},
+                {"<alloc::vec::Vec<_> as core::ops::drop::Drop>::drop", S{K::DROP, {0}, {}}},
+                {"<alloc::boxed::Box<_> as core::ops::drop::Drop>::drop", S{K::DROP, {0}, {}}},
+                {"core::mem::drop::<_>", S{K::DROP, {0}, {}}},
+                {"core::ptr::drop_in_place::<_>", S{K::DROP, {0}, {}}},
+            };
+            return Summaries;
+        }
+    } // anonymous namespace
+
+    std::string erase_generics(llvm::StringRef Demangled)
+    {
+        std::string erased;
+        erased.reserve(Demangled.size());
+        size_t i = 0;
+        while (i < Demangled.size())
+        {
+            const char c = Demangled[i];
+            const bool after_ident = !erased.empty() && is_ident_char(erased.back());
+            if (c == '<' && (after_ident || llvm::StringRef(erased).endswith("::")))
+            {
+                // generic arguments, a '<' anywhere else starts a qualified path
+                i = skip_brackets(Demangled, i, '<', '>');
+                erased += "<_>";
+            }
+            else if (c == '[' && after_ident)
+            {
+                // crate disambiguator
+                i = skip_brackets(Demangled, i, '[', ']');
+            }
+            else if (c == '[')
+            {
+                // slice or array type
+                i = skip_brackets(Demangled, i, '[', ']');
+                erased += "[_]";
+            }
+            else
+            {
+                erased += c;
+                ++i;
+            }
+        }
+        return erased;
+    }
+
+    const StdSummary *lookup_std_summary(llvm::StringRef Demangled)
+    {
+        const auto &summaries = std_summaries();
+        auto it = summaries.find(erase_generics(Demangled));
+        return it == summaries.end() ? nullptr : &it->second;
+    }
+
+    bool is_std_function(llvm::StringRef Demangled)
+    {
+        static const llvm::StringSet<> std_roots = {
+            "core", "alloc", "std",
+            // primitive types, their inherent and trait methods are defined in core
+            "str", "bool", "char", "f32", "f64",
+            "u8", "u16", "u32", "u64", "u128", "usize",
+            "i8", "i16", "i32", "i64", "i128", "isize"};
+        static const llvm::StringSet<> crate_roots = {"core", "alloc", "std"};
+
+        // the self type decides, e.g. <alloc::vec::Vec<_>>::as_mut_ptr
+        auto self_type = Demangled;
+        if (Demangled.startswith("<"))
+        {
+            const auto qualified = Demangled.take_front(skip_brackets(Demangled, 0, '<', '>')).drop_front().drop_back();
+            const auto as = find_top_level(qualified, " as ");
+            if (as != llvm::StringRef::npos)
+            {
+                // a trait implemented outside of core/alloc/std, even for a std type, is user code,
+                // e.g. <alloc::vec::Vec<u8> as my_crate::BufMut>::put
+                if (!is_crate_root(qualified.drop_front(as + 4), crate_roots))
+                {
+                    return false;
+                }
+                self_type = qualified.take_front(as);
+            }
+        }
+        auto path = self_type.ltrim("<&* ");
+        for (const llvm::StringRef prefix : {"mut ", "const ", "dyn "})
+        {
+            path.consume_front(prefix);
+        }
+        if (path.startswith("["))
+        {
+            return true;
+        }
+        return is_crate_root(path, std_roots);
+    }
+
+} // namespace psr
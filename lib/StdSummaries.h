@@ -0,0 +1,63 @@
+#ifndef STD_SUMMARIES_H
+#define STD_SUMMARIES_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <set>
+#include <string>
+
+namespace psr
+{
+
+    /**
+     * What a function of the Rust standard library does with the memory
+     * behind its arguments, as far as the unsafe drop analyses care.
+     */
+    enum class StdFnKind
+    {
+        // returns a raw pointer to memory owned by an argument, e.g. Box::into_raw, Vec::as_mut_ptr
+        RAW_PTR_OUT,
+        // takes over the memory behind a raw pointer argument, e.g. Box::from_raw, Vec::from_raw_parts
+        RAW_PTR_IN,
+        // releases the memory owned by an argument, e.g. drop_in_place
+        DROP,
+    };
+
+    /**
+     * Precomputed effect of a generic std/alloc/core function, valid for all of
+     * its monomorphizations, so an analysis can apply it at the call site
+     * instead of analyzing the body of every copy in the module.
+     */
+    struct StdSummary
+    {
+        StdFnKind Kind;
+        // the arguments whose memory is taken over (RAW_PTR_IN) or released (DROP)
+        std::set<int> ConsumedParams;
+        // the arguments whose taint flows into the return value, including an sret argument
+        std::set<int> TaintToReturn;
+    };
+
+    /**
+     * The demangled path Demangled with all generic arguments replaced by a
+     * single "_" and crate disambiguators removed, e.g.
+     * "<alloc::vec::Vec<u8, alloc::alloc::Global>>::from_raw_parts" becomes
+     * "<alloc::vec::Vec<_>>::from_raw_parts". The element types of slices and
+     * arrays are erased as well, "<[u8]>::as_mut_ptr" becomes "<[_]>::as_mut_ptr".
+     */
+    std::string erase_generics(llvm::StringRef Demangled);
+
+    // the summary of the function with the demangled path, nullptr if there is none
+    const StdSummary *lookup_std_summary(llvm::StringRef Demangled);
+
+    /**
+     * True if the demangled path belongs to the core, alloc or std crates,
+     * including the inherent methods of primitive types, slices and str.
+     * Methods of user types implementing std traits do not belong to them, and
+     * neither do methods of user traits implemented for std types, e.g.
+     * "<alloc::vec::Vec<u8> as my_crate::BufMut>::put".
+     */
+    bool is_std_function(llvm::StringRef Demangled);
+
+} // namespace psr
+
+#endif // STD_SUMMARIES_H
@@ -0,0 +1,177 @@
+#include "TaintConfigs.h"
+
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/InstrTypes.h"
+
+#include <filesystem>
+#include <set>
+
+namespace psr
+{
+
+    FunctionNameIndex::FunctionNameIndex(llvm::ArrayRef<const llvm::Function *> Functions)
+    {
+        for (const auto *f : Functions)
+        {
+            ByLinkageName.try_emplace(f->getName(), f);
+            if (const auto *sub = f->getSubprogram())
+            {
+                BySourceName[sub->getName().split("<").first].push_back(f);
+            }
+        }
+        // one substring test per source name instead of one per monomorphization
+        for (const auto &entry : BySourceName)
+        {
+            if (entry.getKey().contains("drop"))
+            {
+                PHASAR_LOG_LEVEL(INFO, "drop implementation found (w/o <...>): " << entry.getKey());
+                DropImplementations.insert(DropImplementations.end(), entry.getValue().begin(), entry.getValue().end());
+            }
+        }
+    }
+
+    const llvm::Function *FunctionNameIndex::lookup(llvm::StringRef LinkageName) const
+    {
+        return ByLinkageName.lookup(LinkageName);
+    }
+
+    llvm::ArrayRef<const llvm::Function *> FunctionNameIndex::lookupSourceName(llvm::StringRef SourceName) const
+    {
+        auto it = BySourceName.find(SourceName);
+        if (it == BySourceName.end())
+        {
+            return {};
+        }
+        return it->getValue();
+    }
+
+    std::optional<TaintConfigData> load_taint_config(const std::string &Path, const FunctionNameIndex &Index)
+    {
+        if (!std::filesystem::is_regular_file(Path))
+        {
+            PHASAR_LOG_LEVEL(ERROR, "taint config " << Path << " does not exist");
+            return std::nullopt;
+        }
+        auto config = parseTaintConfigOrNull(Path);
+        if (!config)
+        {
+            PHASAR_LOG_LEVEL(ERROR, "could not parse taint config " << Path);
+            return std::nullopt;
+        }
+        for (const auto &function : config->Functions)
+        {
+            if (!Index.lookup(function.Name))
+            {
+                PHASAR_LOG_LEVEL(WARNING, "function " << function.Name << " of taint config " << Path << " is not part of the module");
+            }
+        }
+        return config;
+    }
+
+    namespace
+    {
+        void add_alloc_sources(TaintConfigData &Config)
+        {
+            Config.Functions.push_back(
+                FunctionData{
+                    .Name = "__rust_alloc",
+                    .ReturnCat = TaintCategory::Source,
+                });
+            Config.Functions.push_back(
+                FunctionData{
+                    .Name = "__rust_alloc_zeroed",
+                    .ReturnCat = TaintCategory::Source,
+                });
+        }
+    } // anonymous namespace
+
+    TaintConfigData alloc_taint_config()
+    {
+        TaintConfigData config;
+        add_alloc_sources(config);
+        config.Functions.push_back(
+            FunctionData{
+                .Name = "__rust_dealloc",
+                .HasAllSinkParam = true,
+            });
+        return config;
+    }
+
+    TaintConfigData unsafe_taint_config()
+    {
+        TaintConfigData config;
+        config.Functions.push_back(
+            FunctionData{
+                .Name = "sink",
+                .HasAllSinkParam = true,
+            });
+        add_alloc_sources(config);
+        return config;
+    }
+
+    void add_drop_sinks(TaintConfigData &Config, const FunctionNameIndex &Index)
+    {
+        for (const auto *f : Index.dropImplementations())
+        {
+            Config.Functions.push_back(
+                FunctionData{
+                    .Name = f->getName().str(),
+                    .HasAllSinkParam = true,
+                });
+        }
+    }
+
+    std::optional<named_taint_configs_t> taint_configs(const std::vector<std::string> &ConfigFiles, TaintConfigData (*BuiltIn)(),
+                                                       const FunctionNameIndex &Index, bool AddDropSinks)
+    {
+        named_taint_configs_t configs;
+        if (ConfigFiles.empty())
+        {
+            configs.emplace_back("built-in", BuiltIn());
+        }
+        for (const auto &config_file : ConfigFiles)
+        {
+            auto config = load_taint_config(config_file, Index);
+            if (!config)
+            {
+                return std::nullopt;
+            }
+            configs.emplace_back(config_file, std::move(*config));
+        }
+        if (AddDropSinks)
+        {
+            for (auto &config : configs)
+            {
+                add_drop_sinks(config.second, Index);
+            }
+        }
+        return configs;
+    }
+
+    LLVMTaintConfig::TaintDescriptionCallBackTy unsafe_sources_callback(const UnsafeCode &Unsafe)
+    {
+        return [&Unsafe](const llvm::Instruction *I)
+        {
+            std::set<const llvm::Value *> sources;
+            const auto *call = llvm::dyn_cast<llvm::CallBase>(I);
+            if (!call || !Unsafe.contains(call))
+            {
+                return sources;
+            }
+            if (!call->getType()->isVoidTy())
+            {
+                sources.insert(call);
+            }
+            // all sret(%Type) marked arguments are considered return values and therefore tainted
+            for (unsigned arg = 0; arg < call->arg_size(); ++arg)
+            {
+                if (call->paramHasAttr(arg, llvm::Attribute::StructRet))
+                {
+                    sources.insert(call->getArgOperand(arg));
+                }
+            }
+            return sources;
+        };
+    }
+
+} // namespace psr
@@ -0,0 +1,83 @@
+#ifndef TAINT_CONFIGS_H
+#define TAINT_CONFIGS_H
+
+#include "phasar.h"
+#include "UnsafeFunctions.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Function.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Index of the functions of a module by linkage name and by source name,
+     * built once and shared by all taint configs analyzed on that module.
+     *
+     * The source name is the name of the DISubprogram without generic
+     * arguments, so all monomorphizations of a function share one entry.
+     */
+    class FunctionNameIndex
+    {
+    private:
+        llvm::StringMap<const llvm::Function *> ByLinkageName;
+        llvm::StringMap<std::vector<const llvm::Function *>> BySourceName;
+        std::vector<const llvm::Function *> DropImplementations;
+
+    public:
+        explicit FunctionNameIndex(llvm::ArrayRef<const llvm::Function *> Functions);
+
+        // function with the given linkage name, nullptr if there is none
+        [[nodiscard]] const llvm::Function *lookup(llvm::StringRef LinkageName) const;
+
+        // all functions with the given source name (without generic arguments)
+        [[nodiscard]] llvm::ArrayRef<const llvm::Function *> lookupSourceName(llvm::StringRef SourceName) const;
+
+        // all functions whose source name (without generic arguments) contains "drop"
+        [[nodiscard]] llvm::ArrayRef<const llvm::Function *> dropImplementations() const { return DropImplementations; }
+    }; // class FunctionNameIndex
+
+    /**
+     * Parse a taint config in the JSON format of the files in analysis-configs.
+     * Returns std::nullopt and logs an error if the file cannot be parsed.
+     * Functions of the config that are not part of the module are logged as warnings.
+     */
+    std::optional<TaintConfigData> load_taint_config(const std::string &Path, const FunctionNameIndex &Index);
+
+    // __rust_alloc and __rust_alloc_zeroed as sources, __rust_dealloc as sink with all parameters
+    TaintConfigData alloc_taint_config();
+
+    // __rust_alloc and __rust_alloc_zeroed as sources, sink as sink with all parameters,
+    // used together with unsafe_sources_callback
+    TaintConfigData unsafe_taint_config();
+
+    // add all drop implementations of the module as sinks with all parameters
+    void add_drop_sinks(TaintConfigData &Config, const FunctionNameIndex &Index);
+
+    using named_taint_configs_t = std::vector<std::pair<std::string, TaintConfigData>>;
+
+    /**
+     * The taint configs of one taint analysis, named by their file: the ones
+     * loaded from ConfigFiles, or BuiltIn named "built-in" if there are none.
+     * With AddDropSinks, the drop implementations of the module are added to
+     * each as sinks. Returns std::nullopt if a config file cannot be parsed.
+     */
+    std::optional<named_taint_configs_t> taint_configs(const std::vector<std::string> &ConfigFiles, TaintConfigData (*BuiltIn)(),
+                                                       const FunctionNameIndex &Index, bool AddDropSinks = true);
+
+    /**
+     * Source callback for LLVMTaintConfig::registerSourceCallBack: every call
+     * that executes inside unsafe code is a source of its return value and its
+     * sret arguments. Unsafe must outlive the taint config.
+     */
+    LLVMTaintConfig::TaintDescriptionCallBackTy unsafe_sources_callback(const UnsafeCode &Unsafe);
+
+} // namespace psr
+
+#endif // TAINT_CONFIGS_H
@@ -0,0 +1,304 @@
+#include "TaintEngines.h"
+#include "ConcurrentHelperAnalyses.h"
+#include "DemangleCache.h"
+#include "Instrumentation.h"
+#include "StdSummaries.h"
+#include "TaintConfigs.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <future>
+
+namespace psr
+{
+
+    namespace
+    {
+        /**
+         * IFDSTaintAnalysis applying the summaries of the std functions that pass a
+         * pointer through, e.g. Box::into_raw or Vec::from_raw_parts, at their call
+         * sites instead of descending into each of their monomorphized bodies.
+         * IDEExtendedTaintAnalysis has no such summaries, so they are only applied
+         * if the leaks of the two engines are not compared.
+         */
+        class StdSummaryTaintAnalysis : public IFDSTaintAnalysis
+        {
+        public:
+            using IFDSTaintAnalysis::IFDSTaintAnalysis;
+
+            FlowFunctionPtrType getSummaryFlowFunction(n_t CallSite, f_t DestFun) override
+            {
+                if (auto base = IFDSTaintAnalysis::getSummaryFlowFunction(CallSite, DestFun))
+                {
+                    return base;
+                }
+                if (!ApplySummaries)
+                {
+                    return nullptr;
+                }
+                const auto *summary = lookup(DestFun);
+                if (!summary || summary->TaintToReturn.empty())
+                {
+                    return nullptr;
+                }
+                ++NumApplied;
+                const auto *call = llvm::cast<llvm::CallBase>(CallSite);
+                return lambdaFlow<d_t>([call, summary](d_t Source) -> container_type
+                                       {
+                                           container_type facts = {Source};
+                                           const bool tainted = llvm::any_of(summary->TaintToReturn, [&](int Idx)
+                                                                             { return Idx < static_cast<int>(call->arg_size()) && call->getArgOperand(Idx) == Source; });
+                                           if (!tainted)
+                                           {
+                                               return facts;
+                                           }
+                                           if (!call->getType()->isVoidTy())
+                                           {
+                                               facts.insert(call);
+                                           }
+                                           for (unsigned idx = 0; idx < call->arg_size(); ++idx)
+                                           {
+                                               if (call->paramHasAttr(idx, llvm::Attribute::StructRet))
+                                               {
+                                                   facts.insert(call->getArgOperand(idx));
+                                               }
+                                           }
+                                           return facts; });
+            }
+
+            size_t numApplied() const noexcept { return NumApplied; }
+
+            void applySummaries(bool Apply) noexcept { ApplySummaries = Apply; }
+
+        private:
+            const StdSummary *lookup(f_t F)
+            {
+                auto it = Summaries.find(F);
+                if (it == Summaries.end())
+                {
+                    it = Summaries.try_emplace(F, lookup_std_summary(DemangleCache::global().demangle(F))).first;
+                }
+                return it->second;
+            }
+
+            llvm::DenseMap<f_t, const StdSummary *> Summaries;
+            size_t NumApplied = 0;
+            bool ApplySummaries = true;
+        };
+
+        XTaint::LeakMap_t solve_ifds(HelperAnalyses &HA, const LLVMTaintConfig &TaintConfig,
+                                     const std::vector<std::string> &EntryPoints, const std::string &Name,
+                                     bool StdSummaries, std::string *ResultsDump)
+        {
+            StdSummaryTaintAnalysis problem(&HA.getProjectIRDB(), &HA.getAliasInfo(), &TaintConfig, EntryPoints);
+            problem.applySummaries(StdSummaries);
+            IFDSSolver solver(problem, &HA.getICFG());
+            auto results = [&]
+            {
+                auto phase = Instrumentation::global().phase(Name + "/ifds_solve");
+                return solver.solve();
+            }();
+            if (Instrumentation::global().enabled())
+            {
+                Instrumentation::global().setCounter(Name + ".ifds.result_cells", results.getAllResultEntries().size());
+                Instrumentation::global().setCounter(Name + ".ifds.std_summaries_applied", problem.numApplied());
+            }
+            if (ResultsDump)
+            {
+                llvm::raw_string_ostream OS(*ResultsDump);
+                results.dumpResults(HA.getICFG(), OS);
+            }
+            auto leaks = convert_leaks(problem.Leaks);
+            Instrumentation::global().setCounter(Name + ".ifds.leaks", leaks.size());
+            return leaks;
+        }
+
+        XTaint::LeakMap_t solve_ide_xtaint(HelperAnalyses &HA, const LLVMTaintConfig &TaintConfig,
+                                           const std::vector<std::string> &EntryPoints, const std::string &Name)
+        {
+            auto problem = createAnalysisProblem<IDEExtendedTaintAnalysis<>>(HA, TaintConfig, EntryPoints);
+            IDESolver solver(problem, &HA.getICFG());
+            auto results = [&]
+            {
+                auto phase = Instrumentation::global().phase(Name + "/ide_xtaint_solve");
+                return solver.solve();
+            }();
+            if (Instrumentation::global().enabled())
+            {
+                Instrumentation::global().setCounter(Name + ".ide_xtaint.result_cells", results.getAllResultEntries().size());
+            }
+            auto leaks = problem.getAllLeaks(results);
+            Instrumentation::global().setCounter(Name + ".ide_xtaint.leaks", leaks.size());
+            return leaks;
+        }
+
+        // the values of Leaks[Sink] that are not in Other[Sink]
+        llvm::SmallVector<const llvm::Value *, 1> leaked_only_by(const XTaint::LeakMap_t &Leaks,
+                                                                 const XTaint::LeakMap_t &Other,
+                                                                 const llvm::Instruction *Sink)
+        {
+            llvm::SmallVector<const llvm::Value *, 1> only;
+            auto it = Leaks.find(Sink);
+            if (it == Leaks.end())
+            {
+                return only;
+            }
+            auto other = Other.find(Sink);
+            for (const auto *value : it->second)
+            {
+                if (other == Other.end() || !other->second.contains(value))
+                {
+                    only.push_back(value);
+                }
+            }
+            return only;
+        }
+    } // anonymous namespace
+
+    XTaint::LeakMap_t convert_leaks(const std::map<const llvm::Instruction *, std::set<const llvm::Value *>> &Leaks)
+    {
+        XTaint::LeakMap_t map;
+        for (const auto &[sink, values] : Leaks)
+        {
+            auto &set = map[sink];
+            for (const auto *value : values)
+            {
+                set.insert(value);
+            }
+        }
+        return map;
+    }
+
+    TaintEngineLeaks solve_taint_engines(HelperAnalyses &HA, const LLVMTaintConfig &TaintConfig,
+                                         const std::vector<std::string> &EntryPoints, const std::string &Name,
+                                         bool Parallel, bool StdSummaries, llvm::raw_ostream *IFDSResultsDump)
+    {
+        TaintEngineLeaks leaks;
+        std::string dump;
+        std::string *dump_ptr = IFDSResultsDump ? &dump : nullptr;
+        if (Parallel)
+        {
+            {
+                auto phase = Instrumentation::global().phase("points_to");
+                prepare_for_concurrent_reads(HA);
+            }
+            auto ifds_future = std::async(std::launch::async, [&]
+                                          { return solve_ifds(HA, TaintConfig, EntryPoints, Name, StdSummaries, dump_ptr); });
+            leaks.IDEXTaint = solve_ide_xtaint(HA, TaintConfig, EntryPoints, Name);
+            leaks.IFDS = ifds_future.get();
+        }
+        else
+        {
+            leaks.IFDS = solve_ifds(HA, TaintConfig, EntryPoints, Name, StdSummaries, dump_ptr);
+            leaks.IDEXTaint = solve_ide_xtaint(HA, TaintConfig, EntryPoints, Name);
+        }
+        if (IFDSResultsDump)
+        {
+            *IFDSResultsDump << dump;
+        }
+        return leaks;
+    }
+
+    std::vector<LeakDiff> diff_leaks(const TaintEngineLeaks &Leaks)
+    {
+        std::vector<LeakDiff> diff;
+        llvm::DenseSet<const llvm::Instruction *> seen;
+        for (const auto *map : {&Leaks.IFDS, &Leaks.IDEXTaint})
+        {
+            for (const auto &leak : *map)
+            {
+                const auto *sink = leak.first;
+                if (!seen.insert(sink).second)
+                {
+                    continue;
+                }
+                LeakDiff sink_diff{sink,
+                                   leaked_only_by(Leaks.IFDS, Leaks.IDEXTaint, sink),
+                                   leaked_only_by(Leaks.IDEXTaint, Leaks.IFDS, sink)};
+                if (sink_diff.OnlyIFDS.empty() && sink_diff.OnlyIDEXTaint.empty())
+                {
+                    continue;
+                }
+                diff.push_back(std::move(sink_diff));
+            }
+        }
+        return diff;
+    }
+
+    void print_leak_diff(llvm::ArrayRef<LeakDiff> Diff, llvm::raw_ostream &OS)
+    {
+        OS << Diff.size() << " sinks with leaks found by only one engine:\n";
+        for (const auto &sink_diff : Diff)
+        {
+            OS << "IR: " << *sink_diff.Sink << "\n";
+            for (const auto *value : sink_diff.OnlyIFDS)
+            {
+                OS << " -> only IFDS Taint: " << *value << "\n";
+            }
+            for (const auto *value : sink_diff.OnlyIDEXTaint)
+            {
+                OS << " -> only IDE XTaint: " << *value << "\n";
+            }
+        }
+        OS << "\n";
+    }
+
+    void print_leaks(const XTaint::LeakMap_t &Leaks, llvm::raw_ostream &OS, bool WithMetadataIds)
+    {
+        for (const auto &[sink, values] : Leaks)
+        {
+            OS << "IR: " << *sink << " -> Leaks values: \n";
+            for (const auto *value : values)
+            {
+                OS << " -> Value: " << *value;
+                if (WithMetadataIds)
+                {
+                    OS << " Metadata: " << getMetaDataID(value);
+                }
+                OS << "\n";
+            }
+        }
+        OS << "\n";
+    }
+
+    TaintEngineLeaks run_taint_config(HelperAnalyses &HA, const std::string &Name, const TaintConfigData &Config,
+                                      const UnsafeCode *Unsafe, const TaintRunOptions &Opts, llvm::raw_ostream &OS)
+    {
+        LLVMTaintConfig taint_config(HA.getProjectIRDB(), Config);
+        if (Unsafe)
+        {
+            taint_config.registerSourceCallBack(unsafe_sources_callback(*Unsafe));
+        }
+        OS << "taint config:\n"
+           << taint_config << "\n";
+
+        PHASAR_LOG_LEVEL(INFO, "Solving IFDSTaintAnalysis and IDEXTaintAnalysis taint problems");
+        const std::vector<std::string> entry_points = {"main"};
+        auto leaks = solve_taint_engines(HA, taint_config, entry_points, Name, Opts.Parallel, Opts.StdSummaries,
+                                         Opts.DumpIFDSResults ? &OS : nullptr);
+
+        OS << "\n"
+           << leaks.IFDS.size()
+           << " leaks found using IFDS Taint:\n";
+        print_leaks(leaks.IFDS, OS, Opts.PrintMetadataIds);
+
+        OS << "\n"
+           << leaks.IDEXTaint.size()
+           << " leaks found using IDE XTaint:\n";
+        print_leaks(leaks.IDEXTaint, OS, Opts.PrintMetadataIds);
+
+        OS << "\nComparison of the IFDS Taint and IDE XTaint leaks:\n";
+        if (Opts.StdSummaries)
+        {
+            // the engines do not see the same calls into std
+            OS << "(skipped, the std summaries only apply to IFDS Taint)\n\n";
+        }
+        else
+        {
+            print_leak_diff(diff_leaks(leaks), OS);
+        }
+        return leaks;
+    }
+
+} // namespace psr
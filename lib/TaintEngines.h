@@ -0,0 +1,92 @@
+#ifndef TAINT_ENGINES_H
+#define TAINT_ENGINES_H
+
+#include "phasar.h"
+#include "UnsafeFunctions.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    // the leaks of IFDSTaintAnalysis in the format of IDEExtendedTaintAnalysis
+    XTaint::LeakMap_t convert_leaks(const std::map<const llvm::Instruction *, std::set<const llvm::Value *>> &Leaks);
+
+    /**
+     * The leaks both taint engines found for one taint config.
+     */
+    struct TaintEngineLeaks
+    {
+        XTaint::LeakMap_t IFDS;
+        XTaint::LeakMap_t IDEXTaint;
+    };
+
+    /**
+     * Solve IFDSTaintAnalysis and IDEExtendedTaintAnalysis<> for TaintConfig.
+     *
+     * With Parallel, HA is prepared for concurrent reads first (see
+     * prepare_for_concurrent_reads) and the IFDS problem is solved on a second
+     * thread while the IDE problem is solved on the calling one. Both solvers
+     * only read HA and TaintConfig, each owns its problem and results. Running
+     * both at once adds up their peak memory, so tools offer a sequential mode.
+     *
+     * Each solve is an Instrumentation phase, <Name>/ifds_solve and
+     * <Name>/ide_xtaint_solve. If IFDSResultsDump is set, the IFDS results are
+     * dumped to it once both solves are done.
+     *
+     * With StdSummaries, the IFDS problem applies the std summaries (see
+     * lookup_std_summary) at the calls into std instead of entering them. The
+     * IDE problem has no summaries, so its leaks are not comparable then.
+     */
+    TaintEngineLeaks solve_taint_engines(HelperAnalyses &HA, const LLVMTaintConfig &TaintConfig,
+                                         const std::vector<std::string> &EntryPoints, const std::string &Name,
+                                         bool Parallel, bool StdSummaries, llvm::raw_ostream *IFDSResultsDump = nullptr);
+
+    /**
+     * The values leaked at one sink by only one of the engines.
+     */
+    struct LeakDiff
+    {
+        const llvm::Instruction *Sink;
+        llvm::SmallVector<const llvm::Value *, 1> OnlyIFDS;
+        llvm::SmallVector<const llvm::Value *, 1> OnlyIDEXTaint;
+    };
+
+    // every sink at which the engines disagree on the leaked values
+    std::vector<LeakDiff> diff_leaks(const TaintEngineLeaks &Leaks);
+
+    void print_leak_diff(llvm::ArrayRef<LeakDiff> Diff, llvm::raw_ostream &OS);
+
+    // every sink with the values leaked there, optionally with the metadata ids PhASAR assigned to them
+    void print_leaks(const XTaint::LeakMap_t &Leaks, llvm::raw_ostream &OS, bool WithMetadataIds = false);
+
+    struct TaintRunOptions
+    {
+        // solve both engines concurrently, see solve_taint_engines
+        bool Parallel = true;
+        // apply the std summaries in the IFDS engine, which skips the comparison of the engines
+        bool StdSummaries = false;
+        bool DumpIFDSResults = false;
+        bool PrintMetadataIds = false;
+    };
+
+    /**
+     * Analyze one taint config with both engines from main: print the config,
+     * solve, print the leaks of each engine and where they differ, unless
+     * Opts.StdSummaries makes them incomparable.
+     * With Unsafe, every call inside unsafe code is an additional source
+     * (see unsafe_sources_callback).
+     */
+    TaintEngineLeaks run_taint_config(HelperAnalyses &HA, const std::string &Name, const TaintConfigData &Config,
+                                      const UnsafeCode *Unsafe, const TaintRunOptions &Opts, llvm::raw_ostream &OS);
+
+} // namespace psr
+
+#endif // TAINT_ENGINES_H
@@ -0,0 +1,92 @@
+#include "TaskGraph.h"
+#include "Instrumentation.h"
+
+#include "llvm/ADT/StringSet.h"
+
+namespace psr
+{
+
+    namespace
+    {
+        enum class Mark
+        {
+            VISITING,
+            DONE,
+        };
+    } // anonymous namespace
+
+    void TaskGraph::add(const std::string &Name, std::vector<std::string> Deps, std::function<bool()> Run)
+    {
+        Tasks[Name] = Task{std::move(Deps), std::move(Run)};
+    }
+
+    bool TaskGraph::run(llvm::ArrayRef<std::string> Targets, llvm::raw_ostream &Log)
+    {
+        // depth first post order of the needed tasks, dependencies first
+        std::vector<std::string> order;
+        llvm::StringMap<Mark> marks;
+        bool valid = true;
+        std::function<void(const std::string &)> visit = [&](const std::string &Name)
+        {
+            auto mark = marks.find(Name);
+            if (mark != marks.end())
+            {
+                if (mark->second == Mark::VISITING)
+                {
+                    Log << "error: dependency cycle through task '" << Name << "'\n";
+                    valid = false;
+                }
+                return;
+            }
+            auto task = Tasks.find(Name);
+            if (task == Tasks.end())
+            {
+                Log << "error: unknown task '" << Name << "'\n";
+                valid = false;
+                return;
+            }
+            marks[Name] = Mark::VISITING;
+            for (const auto &dep : task->second.Deps)
+            {
+                visit(dep);
+            }
+            marks[Name] = Mark::DONE;
+            order.push_back(Name);
+        };
+        for (const auto &target : Targets)
+        {
+            visit(target);
+        }
+        if (!valid)
+        {
+            return false;
+        }
+
+        llvm::StringSet<> failed;
+        for (const auto &name : order)
+        {
+            const auto &task = Tasks[name];
+            bool skip = false;
+            for (const auto &dep : task.Deps)
+            {
+                if (failed.count(dep))
+                {
+                    Log << "skipping task '" << name << "', its dependency '" << dep << "' failed\n";
+                    skip = true;
+                    break;
+                }
+            }
+            if (!skip)
+            {
+                auto phase = Instrumentation::global().phase(name);
+                skip = !task.Run();
+            }
+            if (skip)
+            {
+                failed.insert(name);
+            }
+        }
+        return failed.empty();
+    }
+
+} // namespace psr
@@ -0,0 +1,51 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * A small dependency graph of named analysis passes over one module.
+     *
+     * run() executes only the tasks the requested targets transitively depend
+     * on, each at most once and after all of its dependencies, so a pre-pass
+     * shared by several analyses (e.g. the unsafe code classification) is
+     * computed a single time. Every executed task is an Instrumentation phase
+     * of its name. A task that fails, or whose dependency failed, does not stop
+     * the unrelated tasks.
+     */
+    class TaskGraph
+    {
+    private:
+        struct Task
+        {
+            std::vector<std::string> Deps;
+            std::function<bool()> Run;
+        };
+
+        llvm::StringMap<Task> Tasks;
+
+    public:
+        // Run returns false if the task failed, duplicate names replace the earlier task
+        void add(const std::string &Name, std::vector<std::string> Deps, std::function<bool()> Run);
+
+        /**
+         * Run Targets and their dependencies, in the order of Targets and of the
+         * dependencies of each task. Unknown tasks and dependency cycles
+         * are reported to Log before anything is run.
+         * Returns true if every task that was needed succeeded.
+         */
+        bool run(llvm::ArrayRef<std::string> Targets, llvm::raw_ostream &Log);
+    };
+
+} // namespace psr
+
+#endif // TASK_GRAPH_H
@@ -0,0 +1,192 @@
+#include "UnsafeFunctions.h"
+#include "Instrumentation.h"
+#include "find_unsafe_rs.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/InstrTypes.h"
+
+#include <cstring>
+#include <filesystem>
+#include <tuple>
+
+namespace psr
+{
+
+    UnsafeCode find_unsafe_code(llvm::ArrayRef<const llvm::Function *> Functions,
+                                llvm::raw_ostream *Log,
+                                const std::string &CacheDir)
+    {
+        auto phase = Instrumentation::global().phase("find_unsafe_code");
+        // one query per distinct location of any instruction, answered by a single call into find_unsafe_rs
+        std::vector<std::string> paths;
+        llvm::StringMap<unsigned> path_ids;
+        std::vector<FindUnsafeRsQuery> queries;
+        llvm::DenseMap<std::tuple<unsigned, unsigned, unsigned>, size_t> query_ids;
+        // (instruction, query) for every located instruction, in module order
+        std::vector<std::pair<const llvm::Instruction *, size_t>> located;
+        for (const llvm::Function *const f : Functions)
+        {
+            if (f->isDeclaration())
+            {
+                continue;
+            }
+            for (const auto &I : llvm::instructions(f))
+            {
+                const llvm::DILocation *const loc = I.getDebugLoc().get();
+                // column 0 means the column is unknown, the whole line would be too coarse
+                if (!loc || loc->getLine() == 0 || loc->getColumn() == 0)
+                {
+                    continue;
+                }
+                const auto path = (std::filesystem::path(loc->getDirectory().str()) / loc->getFilename().str()).string();
+                const auto path_id = path_ids.try_emplace(path, paths.size()).first->getValue();
+                if (path_id == paths.size())
+                {
+                    paths.push_back(path);
+                }
+                // DILocation columns start at 1, those of find_unsafe_rs at 0
+                const auto key = std::make_tuple(path_id, loc->getLine(), loc->getColumn() - 1);
+                const auto [it, inserted] = query_ids.try_emplace(key, queries.size());
+                if (inserted)
+                {
+                    queries.push_back(FindUnsafeRsQuery{nullptr, loc->getLine(), loc->getColumn() - 1});
+                }
+                located.emplace_back(&I, it->second);
+            }
+        }
+        // the paths vector is complete, so pointers into it stay valid
+        for (const auto &[key, query_id] : query_ids)
+        {
+            queries[query_id].path = paths[std::get<0>(key)].c_str();
+        }
+        std::vector<FindUnsafeRsResult> results(queries.size());
+        Instrumentation::global().setCounter("find_unsafe.source_files", paths.size());
+        Instrumentation::global().setCounter("find_unsafe.location_queries", queries.size());
+
+        auto *find_unsafe_rs = CacheDir.empty()
+                                   ? find_unsafe_rs_new()
+                                   : find_unsafe_rs_new_with_cache((std::filesystem::path(CacheDir) / "find_unsafe_rs").c_str());
+        // parse every source file once on all cores, the batch query below is then only lookups
+        std::vector<const char *> path_ptrs;
+        path_ptrs.reserve(paths.size());
+        for (const auto &path : paths)
+        {
+            path_ptrs.push_back(path.c_str());
+        }
+        std::vector<int> path_statuses(paths.size());
+        find_unsafe_rs_prepare_files(find_unsafe_rs, path_ptrs.data(), path_ptrs.size(), 0, path_statuses.data());
+        const int err = find_unsafe_rs_is_any_unsafe_location_batch(find_unsafe_rs, queries.data(), queries.size(), results.data());
+        find_unsafe_rs_free(find_unsafe_rs);
+        if (err)
+        {
+            PHASAR_LOG_LEVEL(ERROR, "find_unsafe_rs batch query failed (error " << err << " ): " << strerror(err));
+            return {};
+        }
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            if (path_statuses[i])
+            {
+                PHASAR_LOG_LEVEL(WARNING, "Error in file " << paths[i] << " (error " << path_statuses[i] << " ): " << strerror(path_statuses[i]));
+            }
+        }
+
+        UnsafeCode unsafe_code;
+        llvm::DenseMap<const llvm::Function *, unsigned> num_unsafe_insts;
+        for (const auto &[I, query_id] : located)
+        {
+            if (results[query_id].status || !results[query_id].is_unsafe)
+            {
+                continue;
+            }
+            unsafe_code.Instructions.insert(I);
+            // inlined code is unsafe where it is executed, but does not make the function unsafe
+            if (!I->getDebugLoc()->getInlinedAt())
+            {
+                ++num_unsafe_insts[I->getFunction()];
+            }
+        }
+
+        if (Log)
+        {
+            *Log << "\nDeclared functions [safety]:";
+        }
+        for (const llvm::Function *const f : Functions)
+        {
+            const auto num_unsafe = num_unsafe_insts.lookup(f);
+            if (Log && f->getSubprogram())
+            {
+                *Log << f->getName()
+                     << " ('" << f->getSubprogram()->getName() << "')"
+                     << " : " << f->getSubprogram()->getFilename() << ":"
+                     << f->getSubprogram()->getLine() << " ["
+                     << (num_unsafe ? "unsafe, " + std::to_string(num_unsafe) + " instructions" : "safe")
+                     << "]\n";
+            }
+            if (num_unsafe)
+            {
+                unsafe_code.Functions.push_back(f);
+            }
+        }
+        Instrumentation::global().setCounter("find_unsafe.unsafe_instructions", unsafe_code.Instructions.size());
+        Instrumentation::global().setCounter("find_unsafe.unsafe_functions", unsafe_code.Functions.size());
+        return unsafe_code;
+    }
+
+    std::vector<const llvm::Function *> unsafe_slice(const LLVMBasedICFG &ICFG,
+                                                     llvm::ArrayRef<const llvm::Function *> Unsafe)
+    {
+        // callers and callees are walked separately, a caller of a callee is not in the slice
+        llvm::DenseSet<const llvm::Function *> callers(Unsafe.begin(), Unsafe.end());
+        std::vector<const llvm::Function *> worklist(Unsafe.begin(), Unsafe.end());
+        while (!worklist.empty())
+        {
+            const auto *F = worklist.back();
+            worklist.pop_back();
+            for (const auto *call_site : ICFG.getCallersOf(F))
+            {
+                const auto *caller = call_site->getFunction();
+                if (callers.insert(caller).second)
+                {
+                    worklist.push_back(caller);
+                }
+            }
+        }
+
+        llvm::DenseSet<const llvm::Function *> callees(Unsafe.begin(), Unsafe.end());
+        worklist.assign(Unsafe.begin(), Unsafe.end());
+        while (!worklist.empty())
+        {
+            const auto *F = worklist.back();
+            worklist.pop_back();
+            for (const auto &I : llvm::instructions(F))
+            {
+                if (!llvm::isa<llvm::CallBase>(I))
+                {
+                    continue;
+                }
+                for (const auto *callee : ICFG.getCalleesOfCallAt(&I))
+                {
+                    if (callees.insert(callee).second)
+                    {
+                        worklist.push_back(callee);
+                    }
+                }
+            }
+        }
+
+        std::vector<const llvm::Function *> slice;
+        for (const auto *F : ICFG.getAllFunctions())
+        {
+            if (!F->isDeclaration() && (callers.count(F) || callees.count(F)))
+            {
+                slice.push_back(F);
+            }
+        }
+        return slice;
+    }
+
+} // namespace psr
@@ -0,0 +1,56 @@
+#ifndef UNSAFE_FUNCTIONS_H
+#define UNSAFE_FUNCTIONS_H
+
+#include "phasar.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * The code of a module that executes inside `unsafe` blocks, functions,
+     * traits or impls of the Rust sources.
+     */
+    struct UnsafeCode
+    {
+        // instructions whose debug location lies inside unsafe code
+        llvm::DenseSet<const llvm::Instruction *> Instructions;
+        // functions with at least one of their own (not inlined) instructions in Instructions
+        std::vector<const llvm::Function *> Functions;
+
+        [[nodiscard]] bool contains(const llvm::Instruction *I) const { return Instructions.count(I); }
+    };
+
+    /**
+     * Classify every instruction of Functions by the line and column of its
+     * DILocation, using find_unsafe_rs on the source files referenced by the
+     * debug info. Instructions without a location (or with column 0) are skipped.
+     * All distinct locations are answered by a single batch query.
+     * If Log is set, the safety of every function is printed to it.
+     * If CacheDir is set, the parse results of the source files are cached in
+     * CacheDir/find_unsafe_rs and shared by all runs using the same CacheDir.
+     */
+    UnsafeCode find_unsafe_code(llvm::ArrayRef<const llvm::Function *> Functions,
+                                llvm::raw_ostream *Log = nullptr,
+                                const std::string &CacheDir = "");
+
+    /**
+     * The functions that can reach, or be reached from, the Unsafe functions in
+     * the call graph of the ICFG: the unsafe functions, their transitive callers
+     * and their transitive callees. Only definitions are returned, in the order
+     * of ICFG.getAllFunctions().
+     */
+    std::vector<const llvm::Function *> unsafe_slice(const LLVMBasedICFG &ICFG,
+                                                     llvm::ArrayRef<const llvm::Function *> Unsafe);
+
+} // namespace psr
+
+#endif // UNSAFE_FUNCTIONS_H
@@ -0,0 +1,52 @@
+#include "StdSummaries.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+// the path shapes erase_generics and is_std_function have to get right
+int main()
+{
+    using namespace psr;
+
+    int num_failed = 0;
+    auto check_erased = [&](llvm::StringRef Demangled, llvm::StringRef Expected)
+    {
+        const auto erased = erase_generics(Demangled);
+        if (erased != Expected)
+        {
+            llvm::errs() << "erase_generics(\"" << Demangled << "\") is \"" << erased << "\", expected \"" << Expected << "\"\n";
+            ++num_failed;
+        }
+    };
+    auto check_std = [&](llvm::StringRef Demangled, bool Expected)
+    {
+        if (is_std_function(Demangled) != Expected)
+        {
+            llvm::errs() << "is_std_function(\"" << Demangled << "\") is " << (Expected ? "false" : "true") << "\n";
+            ++num_failed;
+        }
+    };
+
+    check_erased("<alloc::vec::Vec<u8, alloc::alloc::Global>>::as_mut_ptr", "<alloc::vec::Vec<_>>::as_mut_ptr");
+    check_erased("<&mut [u8] as core::fmt::Debug>::fmt", "<&mut [_] as core::fmt::Debug>::fmt");
+    check_erased("core[1a2b]::mem::drop::<alloc::boxed::Box<dyn core::ops::function::Fn() -> u8>>", "core::mem::drop::<_>");
+    check_erased("<alloc::vec::Vec<u8> as myrepo::BufMut>::put", "<alloc::vec::Vec<_> as myrepo::BufMut>::put");
+
+    check_std("<alloc::vec::Vec<u8>>::from_raw_parts", true);
+    check_std("<alloc::vec::Vec<u8> as core::ops::drop::Drop>::drop", true);
+    check_std("<&mut [u8] as core::fmt::Debug>::fmt", true);
+    check_std("<u32 as core::ops::arith::Add<u32>>::add", true);
+    check_std("core::ptr::drop_in_place::<myrepo::Foo>", true);
+    check_std("<myrepo::Foo as core::ops::drop::Drop>::drop", false);
+    check_std("<alloc::vec::Vec<u8> as myrepo::BufMut>::put", false);
+    check_std("<[T] as myrepo::SliceExt>::get_unchecked_ext", false);
+    check_std("<u32 as myrepo::Foo>::bar", false);
+    check_std("<core::option::Option<fn() -> u8> as myrepo::Foo>::bar", false);
+    check_std("myrepo::main", false);
+
+    if (num_failed > 0)
+    {
+        llvm::errs() << num_failed << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
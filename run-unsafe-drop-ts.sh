@@ -5,6 +5,7 @@ DATE=$(date +%Y%m%d)
 FILE=$(basename ${1})
 OUTPATH="output/${DATE}-${FILE}-psr"
 LOGILE="${OUTPATH}/psr-$(date -Is).log.gz"
+FINDINGS="${OUTPATH}/findings-$(date -Is).jsonl"
 mkdir -p ${OUTPATH}
 
-./build/tools/unsafe-drop-ts/unsafe-drop-ts "$@" 2>&1 | gzip -1 -c - > ${LOGILE}
+./build/tools/unsafe-drop-ts/unsafe-drop-ts "$@" --findings ${FINDINGS} 2>&1 | gzip -1 -c - > ${LOGILE}
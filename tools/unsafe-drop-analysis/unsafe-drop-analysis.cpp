@@ -8,6 +8,11 @@
  *****************************************************************************/
 
 #include "phasar.h"
+#include "AnalysisCache.h"
+#include "DoubleLeaks.h"
+#include "Instrumentation.h"
+#include "TaintEngines.h"
+#include "TaintConfigs.h"
 #include "llvm/IR/DebugInfo.h"
 
 #include <filesystem>
@@ -16,78 +21,28 @@
 
 using namespace psr;
 
-/// @brief Convert IFDS leak map to XTaint leak map for uniform data structure
-psr::XTaint::LeakMap_t convert_leaks(std::map<const llvm::Instruction *, std::set<const llvm::Value *>> &leaks)
+/// @brief Run the IFDS and IDE taint analyses with one taint config
+void run_taint_analyses(HelperAnalyses &HA, const std::string &config_name, const TaintConfigData &taint_config_data, const bool parallel)
 {
-  auto map = psr::XTaint::LeakMap_t();
-  for (const auto l : leaks)
-  {
-    auto set = llvm::SmallSet<const llvm::Value *, 1U>();
-    for (const auto v : l.second)
-    {
-      set.insert(v);
-    }
-    map.emplace(std::make_pair(l.first, set));
-  }
-  return map;
-}
+  TaintRunOptions opts;
+  opts.Parallel = parallel;
+  opts.DumpIFDSResults = true;
+  opts.PrintMetadataIds = true;
+  const auto leaks = run_taint_config(HA, config_name, taint_config_data, nullptr, opts, llvm::outs());
 
-void print_leaks(psr::XTaint::LeakMap_t &leaks)
-{
-  for (const auto l : leaks)
-  {
-    llvm::outs() << "IR: " << *l.first << " -> Leaks values: \n";
-    for (const auto v : l.second)
-    {
-      llvm::outs() << " -> Value: " << *v << " Metadata: " << psr::getMetaDataID(v) << "\n";
-    }
-  }
-  llvm::outs() << "\n";
+  PHASAR_LOG_LEVEL(INFO, "Checking for double leak of values:\n");
+  llvm::outs() << "Double leaks found using IFDS Taint:\n";
+  print_double_leaks(find_double_leaks(leaks.IFDS, &HA.getAliasInfo()), llvm::outs());
+  llvm::outs() << "Double leaks found using IDE XTaint:\n";
+  print_double_leaks(find_double_leaks(leaks.IDEXTaint, &HA.getAliasInfo()), llvm::outs());
 }
 
-void find_double_leaks(psr::XTaint::LeakMap_t &leaks)
+void print_usage()
 {
-  // check for a value that is leaked twice
-  PHASAR_LOG_LEVEL(INFO, "Checking for double leak of values:\n");
-
-  auto leaked_values = llvm::DenseSet<const llvm::Value *>();
-  for (const auto leak : leaks)
-  {
-    for (const auto value : leak.second)
-    {
-      leaked_values.insert(value);
-    }
-  }
-
-  auto leaks_per_value = llvm::DenseMap<const llvm::Value *, llvm::SmallSet<const llvm::Instruction *, 2U>>();
-  for (const auto value : leaked_values)
-  {
-    auto instructions = llvm::SmallSet<const llvm::Instruction *, 2U>();
-    for (auto const leak : leaks)
-    {
-      if (leak.second.contains(value))
-      {
-        instructions.insert(leak.first);
-      }
-    }
-    leaks_per_value.insert(std::make_pair(value, instructions));
-  }
-
-  for (const auto value_instrs : leaks_per_value)
-  {
-    if (value_instrs.second.size() >= 2)
-    {
-      llvm::outs() << "Value: " << *value_instrs.first << "\n"
-                   << "is leaked multiple times by instructions: \n";
-      for (auto const instr : value_instrs.second)
-      {
-        llvm::outs() << " -> " << *instr << " ( Opcode = " << instr->getOpcodeName() << " ) \n";
-        if (auto const *cb = llvm::dyn_cast<llvm::CallBase>(instr))
-          llvm::outs() << *cb << " => called function: " << cb->getCalledFunction()->getName() << "\n";
-      }
-      llvm::outs() << "\n";
-    }
-  }
+  llvm::errs() << "unsafe-drop-analysis \n"
+                  "A small PhASAR-based program to check for unsafe drops\n\n"
+                  "Usage: unsafe-drop-analysis <LLVM IR file> [--cache-dir <dir>] [--config <taint config>...] [--stats <path>] [--sequential]\n"
+                  "--sequential solves the IFDS and IDE taint problems one after the other instead of in parallel\n";
 }
 
 int main(int argc, const char **argv)
@@ -101,15 +56,54 @@ int main(int argc, const char **argv)
   if (argc < 2 || !std::filesystem::exists(argv[1]) ||
       std::filesystem::is_directory(argv[1]))
   {
-    llvm::errs() << "unsafe-drop-analysis \n"
-                    "A small PhASAR-based program to check for unsafe drops\n\n"
-                    "Usage: unsafe-drop-analysis <LLVM IR file>\n";
+    print_usage();
     return 1;
   }
 
   std::vector entrypoints = {"main"s};
 
-  HelperAnalyses HA(argv[1], entrypoints);
+  std::string cache_dir;
+  std::vector<std::string> config_files;
+  std::string stats_file;
+  bool parallel = true;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (argv[i] == "--sequential"s)
+    {
+      parallel = false;
+      continue;
+    }
+    // all other flags take a value
+    if (i + 1 >= argc)
+    {
+      print_usage();
+      return 1;
+    }
+    if (argv[i] == "--cache-dir"s)
+    {
+      cache_dir = argv[++i];
+    }
+    else if (argv[i] == "--config"s)
+    {
+      config_files.push_back(argv[++i]);
+    }
+    else if (argv[i] == "--stats"s)
+    {
+      stats_file = argv[++i];
+    }
+    else
+    {
+      print_usage();
+      return 1;
+    }
+  }
+  if (!stats_file.empty())
+  {
+    Instrumentation::global().enableSummary("unsafe-drop-analysis", stats_file);
+  }
+
+  auto HA_ptr = load_helper_analyses(argv[1], entrypoints, cache_dir);
+  auto &HA = *HA_ptr;
 
   const auto *F = HA.getProjectIRDB().getFunctionDefinition("main");
   if (!F)
@@ -120,78 +114,19 @@ int main(int argc, const char **argv)
 
   PHASAR_LOG_LEVEL(INFO, "Testing IFDS taint analysis with alloc as sources and dealloc as sink");
 
-  TaintConfigData taint_config_data;
-
-  taint_config_data.Functions.push_back(
-      FunctionData{
-          .Name = "__rust_alloc",
-          .ReturnCat = TaintCategory::Source,
-      });
-  taint_config_data.Functions.push_back(
-      FunctionData{
-          .Name = "__rust_alloc_zeroed",
-          .ReturnCat = TaintCategory::Source,
-      });
-  taint_config_data.Functions.push_back(
-      FunctionData{
-          .Name = "__rust_dealloc",
-          .HasAllSinkParam = true,
-      });
-
-  // set all drop implementations as sinks
-  for (const llvm::Function *const f : HA.getICFG().getAllFunctions())
+  // the name index is built once, all configs are analyzed on the same module
+  const FunctionNameIndex function_index(HA.getICFG().getAllFunctions());
+  const auto configs = taint_configs(config_files, alloc_taint_config, function_index);
+  if (!configs)
   {
-    const llvm::DISubprogram *const sub = f->getSubprogram();
-    if (!sub)
-    {
-      continue;
-    }
-    auto name = sub->getName().split("<").first;
-    if (name.contains("drop"))
-    {
-      PHASAR_LOG_LEVEL(INFO, "drop implementation found (w/o <...>): " << name);
-      taint_config_data.Functions.push_back(
-          FunctionData{
-              .Name = sub->getLinkageName().str(),
-              .HasAllSinkParam = true,
-          });
-    }
+    return 1;
   }
 
-  LLVMTaintConfig taint_config(HA.getProjectIRDB(), taint_config_data);
-  llvm::outs() << "taint config:\n"
-               << taint_config << "\n";
-
-  IFDSTaintAnalysis ifds_taint_problem(&HA.getProjectIRDB(), &HA.getAliasInfo(), &taint_config);
-
-  PHASAR_LOG_LEVEL(INFO, "Solving IFDSTaintAnalysis taint problem");
-  IFDSSolver S(ifds_taint_problem, &HA.getICFG());
-  auto IFDSResults = S.solve();
-  IFDSResults.dumpResults(HA.getICFG());
-
-  auto ifds_taint_leaks = convert_leaks(ifds_taint_problem.Leaks);
-  llvm::outs() << "\n"
-               << ifds_taint_leaks.size()
-               << " leaks found using IFDS Taint:\n";
-  print_leaks(ifds_taint_leaks);
-  find_double_leaks(ifds_taint_leaks);
-
-  PHASAR_LOG_LEVEL(INFO, "Testing IDE extended taint analysis with unsafe functions as source:");
-
-  const std::vector<std::string> entry_points = {"main"};
-  auto ide_xtaint_problem =
-      createAnalysisProblem<IDEExtendedTaintAnalysis<>>(HA, taint_config, entry_points);
-
-  PHASAR_LOG_LEVEL(INFO, "Solving IDEXTaintAnalysis taint problem");
-  IDESolver IDE_S(ide_xtaint_problem, &HA.getICFG());
-  auto IDEResults = IDE_S.solve();
-
-  auto ide_xtaint_leaks = ide_xtaint_problem.getAllLeaks(IDEResults);
-  llvm::outs() << "\n"
-               << ide_xtaint_leaks.size()
-               << " leaks found using IDE XTaint:\n";
-  print_leaks(ide_xtaint_leaks);
-  find_double_leaks(ide_xtaint_leaks);
+  for (const auto &[config_name, taint_config_data] : *configs)
+  {
+    llvm::outs() << "\n\n###########\n\nTaint config " << config_name << ":\n\n";
+    run_taint_analyses(HA, config_name, taint_config_data, parallel);
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,268 @@
+#include "BatchRunner.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace psr
+{
+
+    namespace
+    {
+
+        struct BatchResult
+        {
+            std::string file;
+            std::string log;
+            std::string findings;
+            std::string stats;
+            // one of: ok, failed, crashed, timeout, error
+            std::string status;
+            int exit_code = -1;
+            int signal = 0;
+            double wall_s = 0;
+            double cpu_s = 0;
+            long max_rss_kb = 0;
+        };
+
+        std::vector<std::string> read_manifest(const std::string &Path)
+        {
+            std::vector<std::string> files;
+            std::ifstream in(Path);
+            std::string line;
+            while (std::getline(in, line))
+            {
+                auto trimmed = llvm::StringRef(line).trim();
+                if (trimmed.empty() || trimmed.startswith("#"))
+                {
+                    continue;
+                }
+                files.push_back(trimmed.str());
+            }
+            return files;
+        }
+
+        double to_seconds(const struct timeval &tv)
+        {
+            return tv.tv_sec + tv.tv_usec / 1e6;
+        }
+
+        // wait for the child, killing it once the deadline has passed (if any)
+        bool wait_for_child(pid_t pid, unsigned timeout_s, int *status, struct rusage *ru)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout_s);
+            bool timed_out = false;
+            for (;;)
+            {
+                const pid_t r = wait4(pid, status, timeout_s ? WNOHANG : 0, ru);
+                if (r == pid)
+                {
+                    return timed_out;
+                }
+                if (r < 0 && errno != EINTR)
+                {
+                    return timed_out;
+                }
+                if (timeout_s && !timed_out && std::chrono::steady_clock::now() >= deadline)
+                {
+                    kill(pid, SIGKILL);
+                    timed_out = true;
+                }
+                if (r == 0)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                }
+            }
+        }
+
+        BatchResult run_one(const std::string &Exe, const std::string &File, const BatchOptions &Opts)
+        {
+            BatchResult result;
+            result.file = File;
+
+            const auto out_dir = std::filesystem::path(Opts.output_dir) / std::filesystem::path(File).relative_path();
+            std::error_code ec;
+            std::filesystem::create_directories(out_dir, ec);
+            result.log = (out_dir / "psr.log").string();
+            result.findings = (out_dir / "findings.jsonl").string();
+            result.stats = (out_dir / "stats.json").string();
+
+            // O_CLOEXEC, so children of the other workers do not inherit this log
+            const int log_fd = open(result.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (log_fd < 0)
+            {
+                result.status = "error";
+                return result;
+            }
+
+            // everything the child needs is prepared before fork,
+            // the child itself only calls async-signal-safe functions
+            std::vector<std::string> args = {Exe, File, "--findings", result.findings, "--stats", result.stats};
+            args.insert(args.end(), Opts.per_file_args.begin(), Opts.per_file_args.end());
+            std::vector<char *> argv;
+            for (auto &arg : args)
+            {
+                argv.push_back(arg.data());
+            }
+            argv.push_back(nullptr);
+            struct rlimit mem_limit;
+            mem_limit.rlim_cur = mem_limit.rlim_max = static_cast<rlim_t>(Opts.mem_limit_mb) * 1024 * 1024;
+
+            const auto start = std::chrono::steady_clock::now();
+            const pid_t pid = fork();
+            if (pid == 0)
+            {
+                dup2(log_fd, STDOUT_FILENO);
+                dup2(log_fd, STDERR_FILENO);
+                if (Opts.mem_limit_mb)
+                {
+                    setrlimit(RLIMIT_AS, &mem_limit);
+                }
+                execv(argv[0], argv.data());
+                _exit(127);
+            }
+            close(log_fd);
+            if (pid < 0)
+            {
+                result.status = "error";
+                return result;
+            }
+
+            int status = 0;
+            struct rusage ru = {};
+            const bool timed_out = wait_for_child(pid, Opts.timeout_s, &status, &ru);
+            result.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.cpu_s = to_seconds(ru.ru_utime) + to_seconds(ru.ru_stime);
+            result.max_rss_kb = ru.ru_maxrss;
+
+            if (timed_out)
+            {
+                result.status = "timeout";
+                result.signal = SIGKILL;
+            }
+            else if (WIFEXITED(status))
+            {
+                result.exit_code = WEXITSTATUS(status);
+                result.status = result.exit_code == 0 ? "ok" : "failed";
+            }
+            else if (WIFSIGNALED(status))
+            {
+                // allocation failures under RLIMIT_AS usually end in SIGABRT or SIGSEGV
+                result.signal = WTERMSIG(status);
+                result.status = "crashed";
+            }
+            else
+            {
+                result.status = "error";
+            }
+            return result;
+        }
+
+        void write_result(llvm::raw_ostream &OS, const BatchResult &R)
+        {
+            llvm::json::OStream J(OS);
+            J.object([&]
+                     {
+                         J.attribute("file", R.file);
+                         J.attribute("status", R.status);
+                         J.attribute("exit_code", R.exit_code);
+                         J.attribute("signal", R.signal);
+                         J.attribute("wall_s", R.wall_s);
+                         J.attribute("cpu_s", R.cpu_s);
+                         J.attribute("max_rss_kb", static_cast<int64_t>(R.max_rss_kb));
+                         J.attribute("log", R.log);
+                         J.attribute("findings", R.findings);
+                         J.attribute("stats", R.stats); });
+            OS << "\n";
+            OS.flush();
+        }
+
+    } // anonymous namespace
+
+    int run_batch(const BatchOptions &Opts)
+    {
+        const auto files = read_manifest(Opts.manifest);
+        if (files.empty())
+        {
+            llvm::errs() << "error: no IR files found in manifest " << Opts.manifest << "\n";
+            return 1;
+        }
+
+        // children re-execute this binary in single file mode
+        std::error_code ec;
+        const auto exe = std::filesystem::read_symlink("/proc/self/exe", ec).string();
+        if (ec)
+        {
+            llvm::errs() << "error: could not determine own executable: " << ec.message() << "\n";
+            return 1;
+        }
+
+        std::filesystem::create_directories(Opts.output_dir, ec);
+        const auto results_path = (std::filesystem::path(Opts.output_dir) / "batch-results.jsonl").string();
+        llvm::raw_fd_ostream results_os(results_path, ec, llvm::sys::fs::OF_Text);
+        if (ec)
+        {
+            llvm::errs() << "error: could not open " << results_path << ": " << ec.message() << "\n";
+            return 1;
+        }
+
+        unsigned jobs = Opts.jobs ? Opts.jobs : std::thread::hardware_concurrency();
+        jobs = std::max(1u, std::min<unsigned>(jobs, files.size()));
+        llvm::outs() << "Analyzing " << files.size() << " IR files with " << jobs << " workers\n";
+
+        std::atomic<size_t> next_file = 0;
+        std::atomic<size_t> num_failed = 0;
+        size_t num_done = 0;
+        std::mutex output_mutex;
+
+        auto worker = [&]
+        {
+            for (size_t i = next_file++; i < files.size(); i = next_file++)
+            {
+                const auto result = run_one(exe, files[i], Opts);
+                if (result.status != "ok")
+                {
+                    ++num_failed;
+                }
+                std::lock_guard<std::mutex> lock(output_mutex);
+                write_result(results_os, result);
+                llvm::outs() << "[" << ++num_done << "/" << files.size() << "] "
+                             << result.status << " " << result.file
+                             << " (" << llvm::format("%.1f", result.wall_s) << "s, "
+                             << result.max_rss_kb / 1024 << " MiB)\n";
+                llvm::outs().flush();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < jobs; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+
+        llvm::outs() << "Batch done: " << files.size() - num_failed << " ok, "
+                     << num_failed << " failed, results in " << results_path << "\n";
+        return num_failed ? 1 : 0;
+    }
+
+} // namespace psr
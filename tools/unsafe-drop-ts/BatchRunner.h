@@ -0,0 +1,45 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Options for analyzing many IR files with a single unsafe-drop-ts invocation.
+     *
+     * Every file of the manifest is analyzed in its own child process, supervised
+     * by a bounded pool of worker threads. The child gets a fresh LLVMContext and
+     * HelperAnalyses, and the memory and time limits are enforced per file, so a
+     * single crate that blows up cannot stall or kill the whole batch.
+     */
+    struct BatchOptions
+    {
+        // file with one LLVM IR path per line, empty lines and lines starting with '#' are ignored
+        std::string manifest;
+        // per file logs are written to <output_dir>/<IR file>/psr.log,
+        // per file findings to <output_dir>/<IR file>/findings.jsonl,
+        // per file phase and counter summaries to <output_dir>/<IR file>/stats.json,
+        // one result record per file is appended to <output_dir>/batch-results.jsonl
+        std::string output_dir = "psr-output";
+        // number of files analyzed in parallel, 0 means one per hardware thread
+        unsigned jobs = 0;
+        // per file address space limit in MiB, 0 means unlimited
+        unsigned long mem_limit_mb = 0;
+        // per file wall clock limit in seconds, 0 means unlimited
+        unsigned timeout_s = 0;
+        // flags forwarded to the analysis of every single file
+        std::vector<std::string> per_file_args;
+    };
+
+    /**
+     * Analyze all files listed in the manifest.
+     * Returns 0 if every file was analyzed successfully, 1 otherwise.
+     */
+    int run_batch(const BatchOptions &Opts);
+
+} // namespace psr
+
+#endif // BATCH_RUNNER_H
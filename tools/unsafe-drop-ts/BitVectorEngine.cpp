@@ -0,0 +1,589 @@
+#include "BitVectorEngine.h"
+#include "CallEffects.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace psr
+{
+
+    namespace
+    {
+        using mask_t = BitVectorEngine::mask_t;
+
+        // no value of the function, its mask is always empty
+        constexpr unsigned NoId = ~0U;
+
+        // a CallEffect and the return flow of the entered callees on the value numbering of its function
+        struct CallIds
+        {
+            llvm::SmallVector<unsigned, 2> Starts;
+            llvm::SmallVector<unsigned, 4> Consumed;
+            UnsafeDropToken Token = UnsafeDropToken::STAR;
+            llvm::SmallVector<const llvm::Function *, 1> Callees;
+            // the call, receiving the mask of the returned value
+            unsigned Ret = NoId;
+            // (parameter index, argument) pairs, the arguments receiving the masks of the parameters
+            llvm::SmallVector<std::pair<unsigned, unsigned>, 4> Actuals;
+        };
+
+        // a MemoryEffect on the value numbering of its function
+        struct MemoryIds
+        {
+            unsigned Src = NoId;
+            llvm::SmallVector<unsigned, 4> Dsts;
+            bool Strong = false;
+        };
+
+        // the non-empty masks at a program point, sorted by value id
+        using facts_t = std::vector<std::pair<unsigned, mask_t>>;
+
+        /**
+         * The masks of all values of a function at one program point. Remembers
+         * which values were set, so clearing and listing the facts costs the
+         * number of facts, not the number of values.
+         */
+        class FactVector
+        {
+        private:
+            std::vector<mask_t> Masks;
+            std::vector<bool> IsSet;
+            std::vector<unsigned> SetIds;
+
+        public:
+            explicit FactVector(size_t NumValues) : Masks(NumValues, 0), IsSet(NumValues, false) {}
+
+            [[nodiscard]] mask_t get(unsigned Id) const { return Id == NoId ? 0 : Masks[Id]; }
+
+            void set(unsigned Id, mask_t Mask)
+            {
+                if (!IsSet[Id])
+                {
+                    IsSet[Id] = true;
+                    SetIds.push_back(Id);
+                }
+                Masks[Id] = Mask;
+            }
+
+            void join(const facts_t &Facts)
+            {
+                for (const auto &[id, mask] : Facts)
+                {
+                    set(id, Masks[id] | mask);
+                }
+            }
+
+            void clear()
+            {
+                for (const auto id : SetIds)
+                {
+                    Masks[id] = 0;
+                    IsSet[id] = false;
+                }
+                SetIds.clear();
+            }
+
+            [[nodiscard]] facts_t facts()
+            {
+                std::sort(SetIds.begin(), SetIds.end());
+                facts_t facts;
+                for (const auto id : SetIds)
+                {
+                    if (Masks[id] != 0)
+                    {
+                        facts.emplace_back(id, Masks[id]);
+                    }
+                }
+                return facts;
+            }
+        }; // class FactVector
+    } // anonymous namespace
+
+    BitVectorEngine::BitVectorEngine(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD, bool UnsafeConstructAsFactory)
+        : HA(HA), TSD(TSD), MaskTransitions(NumUnsafeDropTokens)
+    {
+        const auto &table = UnsafeDropTransitions[UnsafeConstructAsFactory];
+        for (unsigned token = 0; token < NumUnsafeDropTokens; ++token)
+        {
+            for (unsigned mask = 0; mask < (1U << NumUnsafeDropStates); ++mask)
+            {
+                UnsafeDropStateSet next;
+                UnsafeDropStateSet::fromMask(mask).forEach([&](UnsafeDropState S)
+                                                           { next.insert(table[token][state_index(S)]); });
+                MaskTransitions[token][mask] = next.mask();
+            }
+        }
+    }
+
+    BitVectorEngine::CalleeSummary BitVectorEngine::solveFunction(const llvm::Function &F, std::vector<ResultCell> *Cells) const
+    {
+        // dense numbering of the values that can carry a state
+        llvm::DenseMap<const llvm::Value *, unsigned> ids;
+        std::vector<const llvm::Value *> values;
+        auto number = [&](const llvm::Value *V)
+        {
+            ids.try_emplace(V, values.size());
+            values.push_back(V);
+        };
+        for (const auto &arg : F.args())
+        {
+            number(&arg);
+        }
+        for (const auto &I : llvm::instructions(F))
+        {
+            if (!I.getType()->isVoidTy())
+            {
+                number(&I);
+            }
+        }
+        auto id_of = [&](const llvm::Value *V)
+        {
+            auto it = ids.find(V);
+            return it == ids.end() ? NoId : it->second;
+        };
+
+        // resolve the callees, their description and all aliases once, not per iteration
+        const UnsafeDropStateSet start = {TSD.start()};
+        const UnsafeDropStateSet uninit = {TSD.uninit()};
+        llvm::DenseMap<const llvm::Instruction *, CallIds> call_ids;
+        for (const auto &[call, effect] : call_effects(HA, TSD, F))
+        {
+            auto &effect_ids = call_ids[call];
+            effect_ids.Token = effect.Token;
+            for (const auto *V : effect.Starts)
+            {
+                effect_ids.Starts.push_back(id_of(V));
+            }
+            for (const auto *V : effect.Consumed)
+            {
+                effect_ids.Consumed.push_back(id_of(V));
+            }
+        }
+        for (const auto &I : llvm::instructions(F))
+        {
+            const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+            if (!call)
+            {
+                continue;
+            }
+            auto callees = entered_callees(HA, TSD, *call);
+            if (callees.empty())
+            {
+                continue;
+            }
+            auto &effect_ids = call_ids[call];
+            effect_ids.Callees.assign(callees.begin(), callees.end());
+            effect_ids.Ret = id_of(call);
+            for (unsigned idx = 0; idx < call->arg_size(); ++idx)
+            {
+                if (const auto id = id_of(call->getArgOperand(idx)); id != NoId)
+                {
+                    effect_ids.Actuals.emplace_back(idx, id);
+                }
+            }
+        }
+        llvm::DenseMap<const llvm::Instruction *, MemoryIds> memory_ids;
+        for (const auto &[inst, effect] : memory_effects(HA, F))
+        {
+            auto &effect_ids = memory_ids[inst];
+            effect_ids.Src = effect.Src ? id_of(effect.Src) : NoId;
+            effect_ids.Strong = effect.Strong;
+            for (const auto *V : effect.Dsts)
+            {
+                effect_ids.Dsts.push_back(id_of(V));
+            }
+        }
+
+        // the normal flow and call-to-return flow of IDETypeStateAnalysis, allocas and factory calls
+        // generate their state from zero and keep the states the value had on a previous loop iteration
+        auto transfer = [&](const llvm::Instruction &I, FactVector &State)
+        {
+            if (llvm::isa<llvm::AllocaInst>(I))
+            {
+                const auto id = id_of(&I);
+                State.set(id, State.get(id) | uninit.mask());
+                return;
+            }
+            if (auto it = memory_ids.find(&I); it != memory_ids.end())
+            {
+                const auto src = State.get(it->second.Src);
+                for (const auto id : it->second.Dsts)
+                {
+                    State.set(id, it->second.Strong ? src : State.get(id) | src);
+                }
+                return;
+            }
+            auto it = call_ids.find(&I);
+            if (it == call_ids.end())
+            {
+                return;
+            }
+            for (const auto id : it->second.Starts)
+            {
+                State.set(id, State.get(id) | start.mask());
+            }
+            const auto &next = MaskTransitions[token_index(it->second.Token)];
+            for (const auto id : it->second.Consumed)
+            {
+                State.set(id, next[State.get(id)]);
+            }
+            // the return flow joins the states of the callees with the call-to-return flow
+            for (const auto *callee : it->second.Callees)
+            {
+                // a callee of the same recursion that is not solved yet adds nothing
+                auto summary = Summaries.find(callee);
+                if (summary == Summaries.end())
+                {
+                    continue;
+                }
+                if (it->second.Ret != NoId)
+                {
+                    State.set(it->second.Ret, State.get(it->second.Ret) | summary->second.Ret);
+                }
+                for (const auto &[param, id] : it->second.Actuals)
+                {
+                    if (param < summary->second.Params.size())
+                    {
+                        State.set(id, State.get(id) | summary->second.Params[param]);
+                    }
+                }
+            }
+        };
+
+        const llvm::ReversePostOrderTraversal<const llvm::Function *> rpo(&F);
+        const std::vector<const llvm::BasicBlock *> blocks(rpo.begin(), rpo.end());
+        llvm::DenseMap<const llvm::BasicBlock *, unsigned> block_ids;
+        for (unsigned idx = 0; idx < blocks.size(); ++idx)
+        {
+            block_ids[blocks[idx]] = idx;
+        }
+
+        // only the non-empty masks at the end of each block are kept
+        std::vector<facts_t> out(blocks.size());
+        FactVector state(values.size());
+        auto block_entry = [&](unsigned block)
+        {
+            state.clear();
+            for (const auto *pred : llvm::predecessors(blocks[block]))
+            {
+                // unreachable predecessors are not numbered and contribute nothing
+                auto it = block_ids.find(pred);
+                if (it != block_ids.end())
+                {
+                    state.join(out[it->second]);
+                }
+            }
+        };
+
+        // round robin in reverse post order, the masks only grow, so this terminates
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (unsigned block = 0; block < blocks.size(); ++block)
+            {
+                block_entry(block);
+                for (const auto &I : *blocks[block])
+                {
+                    transfer(I, state);
+                }
+                auto facts = state.facts();
+                if (facts != out[block])
+                {
+                    out[block] = std::move(facts);
+                    changed = true;
+                }
+            }
+        }
+
+        // the masks of the return value and the parameters at the exits, and the facts after each
+        // instruction of the values it reads or writes, every state of a value is first reached at such
+        // an instruction, so the states of each value are complete
+        CalleeSummary summary;
+        summary.Params.assign(F.arg_size(), 0);
+        llvm::SmallVector<unsigned, 8> involved;
+        for (unsigned block = 0; block < blocks.size(); ++block)
+        {
+            block_entry(block);
+            for (const auto &I : *blocks[block])
+            {
+                transfer(I, state);
+                if (llvm::isa<llvm::ReturnInst>(I) || llvm::isa<llvm::ResumeInst>(I))
+                {
+                    if (const auto *ret = llvm::dyn_cast<llvm::ReturnInst>(&I); ret && ret->getReturnValue())
+                    {
+                        summary.Ret |= state.get(id_of(ret->getReturnValue()));
+                    }
+                    for (const auto &arg : F.args())
+                    {
+                        summary.Params[arg.getArgNo()] |= state.get(id_of(&arg));
+                    }
+                }
+                if (!Cells)
+                {
+                    continue;
+                }
+                involved.clear();
+                involved.push_back(id_of(&I));
+                for (const auto &op : I.operands())
+                {
+                    involved.push_back(id_of(op.get()));
+                }
+                if (auto it = call_ids.find(&I); it != call_ids.end())
+                {
+                    involved.append(it->second.Starts.begin(), it->second.Starts.end());
+                    involved.append(it->second.Consumed.begin(), it->second.Consumed.end());
+                }
+                if (auto it = memory_ids.find(&I); it != memory_ids.end())
+                {
+                    involved.append(it->second.Dsts.begin(), it->second.Dsts.end());
+                }
+                llvm::sort(involved);
+                involved.erase(std::unique(involved.begin(), involved.end()), involved.end());
+                for (const auto id : involved)
+                {
+                    if (const auto mask = state.get(id))
+                    {
+                        Cells->push_back(ResultCell{&I, values[id], join_of(UnsafeDropStateSet::fromMask(mask))});
+                    }
+                }
+            }
+        }
+        return summary;
+    }
+
+    void BitVectorEngine::summarize(const llvm::Function &Root) const
+    {
+        if (Summaries.count(&Root))
+        {
+            return;
+        }
+
+        // the functions reachable from Root without a summary, in post order of the call graph,
+        // and their callers among them
+        std::vector<const llvm::Function *> post_order;
+        llvm::DenseMap<const llvm::Function *, llvm::SmallVector<const llvm::Function *, 2>> callers;
+        llvm::DenseSet<const llvm::Function *> reached = {&Root};
+        struct Frame
+        {
+            const llvm::Function *F;
+            llvm::SmallVector<const llvm::Function *, 8> Callees;
+            size_t Next = 0;
+        };
+        auto frame_of = [&](const llvm::Function *F)
+        {
+            Frame frame{F, {}, 0};
+            for (const auto &I : llvm::instructions(*F))
+            {
+                if (const auto *call = llvm::dyn_cast<llvm::CallBase>(&I))
+                {
+                    for (const auto *callee : entered_callees(HA, TSD, *call))
+                    {
+                        if (!llvm::is_contained(frame.Callees, callee))
+                        {
+                            frame.Callees.push_back(callee);
+                        }
+                    }
+                }
+            }
+            return frame;
+        };
+        std::vector<Frame> stack;
+        stack.push_back(frame_of(&Root));
+        while (!stack.empty())
+        {
+            auto &top = stack.back();
+            if (top.Next == top.Callees.size())
+            {
+                post_order.push_back(top.F);
+                stack.pop_back();
+                continue;
+            }
+            const auto *callee = top.Callees[top.Next++];
+            if (Summaries.count(callee))
+            {
+                continue;
+            }
+            callers[callee].push_back(top.F);
+            if (reached.insert(callee).second)
+            {
+                // top is invalidated by the push
+                stack.push_back(frame_of(callee));
+            }
+        }
+
+        // callees first, so only recursion solves a function more than once, the masks only grow,
+        // so this terminates
+        for (const auto *F : post_order)
+        {
+            Summaries[F].Params.assign(F->arg_size(), 0);
+        }
+        std::deque<const llvm::Function *> worklist(post_order.begin(), post_order.end());
+        llvm::DenseSet<const llvm::Function *> queued(post_order.begin(), post_order.end());
+        while (!worklist.empty())
+        {
+            const auto *F = worklist.front();
+            worklist.pop_front();
+            queued.erase(F);
+            auto summary = solveFunction(*F, nullptr);
+            if (summary == Summaries[F])
+            {
+                continue;
+            }
+            Summaries[F] = std::move(summary);
+            for (const auto *caller : callers[F])
+            {
+                if (queued.insert(caller).second)
+                {
+                    worklist.push_back(caller);
+                }
+            }
+        }
+    }
+
+    const BitVectorEngine::CalleeSummary &BitVectorEngine::summaryOf(const llvm::Function &F) const
+    {
+        summarize(F);
+        return Summaries.find(&F)->second;
+    }
+
+    RunResult BitVectorEngine::solve(llvm::ArrayRef<const llvm::Function *> Functions) const
+    {
+        std::vector<ResultCell> cells;
+        for (const auto *F : Functions)
+        {
+            if (!F->isDeclaration())
+            {
+                summarize(*F);
+                solveFunction(*F, &cells);
+            }
+        }
+        std::vector<value_states_t> states;
+        states.reserve(cells.size());
+        for (const auto &cell : cells)
+        {
+            states.emplace_back(cell.Val, UnsafeDropStateSet{cell.State});
+        }
+        return RunResult(std::move(cells), std::move(states));
+    }
+
+    std::vector<const llvm::Function *> entry_functions(HelperAnalyses &HA, const std::vector<std::string> &EntryPoints)
+    {
+        std::vector<const llvm::Function *> functions;
+        if (std::find(EntryPoints.begin(), EntryPoints.end(), "__ALL__") != EntryPoints.end())
+        {
+            for (const auto *F : HA.getProjectIRDB().getAllFunctions())
+            {
+                if (!F->isDeclaration())
+                {
+                    functions.push_back(F);
+                }
+            }
+            return functions;
+        }
+        for (const auto &name : EntryPoints)
+        {
+            if (const auto *F = HA.getProjectIRDB().getFunctionDefinition(name))
+            {
+                functions.push_back(F);
+            }
+        }
+        return functions;
+    }
+
+    size_t compare_runs(const RunResult &IDERun, const RunResult &BitVectorRun, llvm::raw_ostream &OS)
+    {
+        // both are sorted by value, walk them in lockstep
+        const auto ide = IDERun.states();
+        const auto bv = BitVectorRun.states();
+        size_t num_differences = 0;
+        auto report = [&](const llvm::Value *V, UnsafeDropStateSet IDEStates, UnsafeDropStateSet BVStates)
+        {
+            // values without any interesting state do not change the findings
+            if (!is_informative(IDEStates) && !is_informative(BVStates))
+            {
+                return;
+            }
+            ++num_differences;
+            OS << *V << " ==> ide: " << IDEStates << ", bitvector: " << BVStates << "\n";
+        };
+        size_t i = 0;
+        size_t j = 0;
+        while (i < ide.size() || j < bv.size())
+        {
+            if (j == bv.size() || (i < ide.size() && ide[i].first < bv[j].first))
+            {
+                report(ide[i].first, ide[i].second, {});
+                ++i;
+            }
+            else if (i == ide.size() || bv[j].first < ide[i].first)
+            {
+                report(bv[j].first, {}, bv[j].second);
+                ++j;
+            }
+            else
+            {
+                if (ide[i].second != bv[j].second)
+                {
+                    report(ide[i].first, ide[i].second, bv[j].second);
+                }
+                ++i;
+                ++j;
+            }
+        }
+        return num_differences;
+    }
+
+    size_t compare_findings(const RunResult &IDERun, const RunResult &OtherRun, llvm::raw_ostream &OS)
+    {
+        // the filter of the df_uaf section of the report
+        const UnsafeDropStateSet error_states = {UnsafeDropState::DF_ERROR, UnsafeDropState::UAF_ERROR};
+        auto is_finding = [&](UnsafeDropStateSet States)
+        {
+            return is_informative(States) && States.containsAny(error_states);
+        };
+        size_t num_differences = 0;
+        auto check = [&](const llvm::Value *V, UnsafeDropStateSet IDEStates, UnsafeDropStateSet OtherStates)
+        {
+            if (is_finding(IDEStates) != is_finding(OtherStates))
+            {
+                ++num_differences;
+                OS << *V << " ==> finding only in " << (is_finding(IDEStates) ? "ide: " : "other engine: ")
+                   << IDEStates << " vs " << OtherStates << "\n";
+            }
+        };
+        // both are sorted by value, walk them in lockstep
+        const auto ide = IDERun.states();
+        const auto other = OtherRun.states();
+        size_t i = 0;
+        size_t j = 0;
+        while (i < ide.size() || j < other.size())
+        {
+            if (j == other.size() || (i < ide.size() && ide[i].first < other[j].first))
+            {
+                check(ide[i].first, ide[i].second, {});
+                ++i;
+            }
+            else if (i == ide.size() || other[j].first < ide[i].first)
+            {
+                check(other[j].first, {}, other[j].second);
+                ++j;
+            }
+            else
+            {
+                check(ide[i].first, ide[i].second, other[j].second);
+                ++i;
+                ++j;
+            }
+        }
+        return num_differences;
+    }
+
+} // namespace psr
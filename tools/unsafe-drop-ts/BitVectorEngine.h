@@ -0,0 +1,104 @@
+#ifndef BIT_VECTOR_ENGINE_H
+#define BIT_VECTOR_ENGINE_H
+
+#include "phasar.h"
+#include "RunResult.h"
+#include "UnsafeDropStateDescription.h"
+#include "UnsafeDropTransitions.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Gen/kill solver for UnsafeDropStateDescription with bottom-up callee
+     * summaries, an alternative to solving UnsafeDropTypeStateAnalysis with the
+     * IDE solver.
+     *
+     * The states a value may be in are a bitmask indexed by state_index. The
+     * values of a function are numbered densely and only the non-empty masks
+     * are kept per block. Control flow merges are an or of those masks and a
+     * call applies its token to a whole mask with a single table lookup.
+     *
+     * The flow is the one of IDETypeStateAnalysis: allocas start UNINIT,
+     * factory calls generate the start state, loads of pointers and
+     * getelementptrs add the states of their pointer operand and stores of
+     * pointers overwrite the local aliases of their pointer operand, see
+     * MemoryEffect. Aliases are taken from the points-to sets of the helper
+     * analyses restricted to the solved function.
+     *
+     * The call flow kills all facts of the caller, so the states inside a
+     * callee do not depend on its callers, but the IDE solver still enters it
+     * with the zero fact and maps the states of its return value and of its
+     * parameters at its exits back to the call site. These masks are the
+     * CalleeSummary of the callee. Summaries are computed bottom-up over the
+     * call graph, a recursive function is solved again until the summaries of
+     * its callees are stable, and a call site adds them to the masks of the
+     * call and of its arguments.
+     *
+     * The value reported for a cell is the join of its mask. The transitions are
+     * monotone on the chain of states (see UnsafeDropTransitions.h), so this is
+     * the value the IDE solver computes. Cells are only emitted at the
+     * instructions that read or write a value, which is where each of its
+     * states is first reached, so the states of every value are the ones of
+     * the IDE run; --engine both reports any difference.
+     */
+    class BitVectorEngine
+    {
+    public:
+        using mask_t = uint16_t;
+
+        // the masks of the return value and of every parameter, joined over the exits of a function
+        struct CalleeSummary
+        {
+            mask_t Ret = 0;
+            llvm::SmallVector<mask_t, 4> Params;
+
+            bool operator==(const CalleeSummary &Other) const { return Ret == Other.Ret && Params == Other.Params; }
+            bool operator!=(const CalleeSummary &Other) const { return !(*this == Other); }
+        };
+
+    private:
+        HelperAnalyses &HA;
+        const UnsafeDropStateDescription &TSD;
+        // the transition of every token applied to every mask, indexed by [token_index][mask]
+        std::vector<std::array<mask_t, 1U << NumUnsafeDropStates>> MaskTransitions;
+        // the summaries of all functions solved so far and of their transitive callees
+        mutable llvm::DenseMap<const llvm::Function *, CalleeSummary> Summaries;
+
+        // solve F with the current summaries of its callees, emits the cells of F if Cells is given
+        CalleeSummary solveFunction(const llvm::Function &F, std::vector<ResultCell> *Cells) const;
+        // compute the summaries of Root and of all its transitive callees that do not have one yet
+        void summarize(const llvm::Function &Root) const;
+
+    public:
+        BitVectorEngine(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD, bool UnsafeConstructAsFactory);
+
+        // solve the given function definitions, declarations are skipped
+        [[nodiscard]] RunResult solve(llvm::ArrayRef<const llvm::Function *> Functions) const;
+
+        // the summary of the definition F, computed together with those of its callees on first use
+        [[nodiscard]] const CalleeSummary &summaryOf(const llvm::Function &F) const;
+    }; // class BitVectorEngine
+
+    // the definitions named by solver entry points, all definitions for "__ALL__"
+    std::vector<const llvm::Function *> entry_functions(HelperAnalyses &HA, const std::vector<std::string> &EntryPoints);
+
+    // print every value whose states differ between the runs, returns the number of such values
+    size_t compare_runs(const RunResult &IDERun, const RunResult &BitVectorRun, llvm::raw_ostream &OS);
+
+    // print every value that is a DF/UAF finding in only one of the runs, returns the number of such values
+    size_t compare_findings(const RunResult &IDERun, const RunResult &OtherRun, llvm::raw_ostream &OS);
+
+} // namespace psr
+
+#endif // BIT_VECTOR_ENGINE_H
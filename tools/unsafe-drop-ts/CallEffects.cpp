@@ -0,0 +1,150 @@
+#include "CallEffects.h"
+
+#include "DemangleCache.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+
+namespace psr
+{
+
+    namespace
+    {
+        // V and its aliases at At that are values of the function of At, added to Values once
+        void add_local_aliases(HelperAnalyses &HA, const llvm::Value *V, const llvm::Instruction &At,
+                               llvm::SmallVectorImpl<const llvm::Value *> &Values)
+        {
+            const auto &F = *At.getFunction();
+            auto add = [&](const llvm::Value *Alias)
+            {
+                if (is_local_value(Alias, F) && !llvm::is_contained(Values, Alias))
+                {
+                    Values.push_back(Alias);
+                }
+            };
+            add(V);
+            if (const auto *aliases = HA.getAliasInfo().getAliasSet(V, &At))
+            {
+                for (const auto *alias : *aliases)
+                {
+                    add(alias);
+                }
+            }
+        }
+    } // anonymous namespace
+
+    bool is_local_value(const llvm::Value *V, const llvm::Function &F)
+    {
+        if (const auto *arg = llvm::dyn_cast<llvm::Argument>(V))
+        {
+            return arg->getParent() == &F;
+        }
+        if (const auto *I = llvm::dyn_cast<llvm::Instruction>(V))
+        {
+            return I->getFunction() == &F && !I->getType()->isVoidTy();
+        }
+        return false;
+    }
+
+    llvm::SmallVector<const llvm::Value *, 4> local_args_and_aliases(HelperAnalyses &HA, const llvm::CallBase &Call,
+                                                                    const std::set<int> &Idxs)
+    {
+        llvm::SmallVector<const llvm::Value *, 4> values;
+        for (const int idx : Idxs)
+        {
+            if (idx < 0 || unsigned(idx) >= Call.arg_size())
+            {
+                continue;
+            }
+            add_local_aliases(HA, Call.getArgOperand(idx), Call, values);
+        }
+        return values;
+    }
+
+    llvm::SmallVector<const llvm::Function *, 2> entered_callees(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD,
+                                                                 const llvm::CallBase &Call)
+    {
+        llvm::SmallVector<const llvm::Function *, 2> callees;
+        for (const auto *callee : HA.getICFG().getCalleesOfCallAt(&Call))
+        {
+            if (!callee->isDeclaration() && !TSD.isSummarized(*callee) && !llvm::is_contained(callees, callee))
+            {
+                callees.push_back(callee);
+            }
+        }
+        return callees;
+    }
+
+    llvm::DenseMap<const llvm::Instruction *, CallEffect> call_effects(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD,
+                                                                       const llvm::Function &F)
+    {
+        llvm::DenseMap<const llvm::Instruction *, CallEffect> effects;
+        for (const auto &I : llvm::instructions(F))
+        {
+            const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+            if (!call || !call->getCalledFunction())
+            {
+                continue;
+            }
+            const auto name = DemangleCache::global().demangle(call->getCalledFunction());
+            auto &effect = effects[call];
+            if (TSD.isFactoryFunction(name))
+            {
+                for (const int idx : TSD.getFactoryParamIdx(name))
+                {
+                    const llvm::Value *V = idx == -1 ? call : (idx >= 0 && unsigned(idx) < call->arg_size() ? call->getArgOperand(idx) : nullptr);
+                    if (V && is_local_value(V, F))
+                    {
+                        effect.Starts.push_back(V);
+                    }
+                }
+                continue;
+            }
+            effect.Token = TSD.funcNameToToken(name);
+            effect.Consumed = local_args_and_aliases(HA, *call, TSD.getConsumerParamIdx(name));
+        }
+        return effects;
+    }
+
+    llvm::DenseMap<const llvm::Instruction *, MemoryEffect> memory_effects(HelperAnalyses &HA, const llvm::Function &F)
+    {
+        llvm::DenseMap<const llvm::Instruction *, MemoryEffect> effects;
+        auto local_or_null = [&](const llvm::Value *V) -> const llvm::Value *
+        {
+            return is_local_value(V, F) ? V : nullptr;
+        };
+        for (const auto &I : llvm::instructions(F))
+        {
+            // like IDETypeStateAnalysis, only pointers are tracked through memory
+            if (const auto *load = llvm::dyn_cast<llvm::LoadInst>(&I))
+            {
+                if (load->getType()->isPointerTy() && local_or_null(load->getPointerOperand()))
+                {
+                    effects[load] = MemoryEffect{load->getPointerOperand(), {load}, false};
+                }
+            }
+            else if (const auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(&I))
+            {
+                if (local_or_null(gep->getPointerOperand()))
+                {
+                    effects[gep] = MemoryEffect{gep->getPointerOperand(), {gep}, false};
+                }
+            }
+            else if (const auto *store = llvm::dyn_cast<llvm::StoreInst>(&I))
+            {
+                if (!store->getValueOperand()->getType()->isPointerTy())
+                {
+                    continue;
+                }
+                auto &effect = effects[store];
+                effect.Src = local_or_null(store->getValueOperand());
+                effect.Strong = true;
+                add_local_aliases(HA, store->getPointerOperand(), *store, effect.Dsts);
+                llvm::erase_value(effect.Dsts, store->getValueOperand());
+            }
+        }
+        return effects;
+    }
+
+} // namespace psr
@@ -0,0 +1,76 @@
+#ifndef CALL_EFFECTS_H
+#define CALL_EFFECTS_H
+
+#include "phasar.h"
+#include "UnsafeDropStateDescription.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+
+namespace psr
+{
+
+    /**
+     * The effect of one call site on the values of its function, as the
+     * typestate analysis sees it: factory calls set values to the start state,
+     * all other calls apply their token to the consumed arguments.
+     */
+    struct CallEffect
+    {
+        // set to the start state
+        llvm::SmallVector<const llvm::Value *, 2> Starts;
+        // consumed arguments and their aliases, the token is applied to them
+        llvm::SmallVector<const llvm::Value *, 4> Consumed;
+        UnsafeDropToken Token = UnsafeDropToken::STAR;
+    };
+
+    /**
+     * The effect of a load, store or getelementptr on the values of its
+     * function, as the normal flow of IDETypeStateAnalysis sees it: a load of a
+     * pointer and a getelementptr add the states of their pointer operand to
+     * their own, a store of a pointer replaces the states of the local aliases
+     * of its pointer operand by the states of the stored value.
+     */
+    struct MemoryEffect
+    {
+        // the value whose states flow, nullptr if it is not a value of the function and has no states
+        const llvm::Value *Src = nullptr;
+        // the values receiving them
+        llvm::SmallVector<const llvm::Value *, 4> Dsts;
+        // the Dsts lose their own states (store) instead of keeping them (load, getelementptr)
+        bool Strong = false;
+    };
+
+    // true for the arguments of F and the instructions of F that produce a value
+    bool is_local_value(const llvm::Value *V, const llvm::Function &F);
+
+    /**
+     * The values of the function of Call at the parameters Idxs of Call,
+     * together with their aliases at Call. Values of other functions are
+     * dropped, every value is listed once.
+     */
+    llvm::SmallVector<const llvm::Value *, 4> local_args_and_aliases(HelperAnalyses &HA, const llvm::CallBase &Call,
+                                                                    const std::set<int> &Idxs);
+
+    /**
+     * The definitions the IDE solver enters at Call. The call flow of the
+     * typestate analysis kills every fact, but the zero fact still reaches the
+     * callee, and its return flow maps the states of the return value and of
+     * the parameters at its exits back to the call site. Callees the
+     * description summarizes are not entered.
+     */
+    llvm::SmallVector<const llvm::Function *, 2> entered_callees(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD,
+                                                                 const llvm::CallBase &Call);
+
+    // the effect of every direct call in F
+    llvm::DenseMap<const llvm::Instruction *, CallEffect> call_effects(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD,
+                                                                       const llvm::Function &F);
+
+    // the effect of every load, store and getelementptr in F that moves states
+    llvm::DenseMap<const llvm::Instruction *, MemoryEffect> memory_effects(HelperAnalyses &HA, const llvm::Function &F);
+
+} // namespace psr
+
+#endif // CALL_EFFECTS_H
@@ -0,0 +1,591 @@
+#include "DemandQueryEngine.h"
+#include "CallEffects.h"
+#include "UnsafeDropTransitions.h"
+
+#include "DemangleCache.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+
+#include <array>
+#include <cstdint>
+
+namespace psr
+{
+
+    namespace
+    {
+        // the state index at the query for every state index at a program point,
+        // i.e. the transitions of all calls between the two composed
+        using path_t = std::array<uint8_t, NumUnsafeDropStates>;
+
+        path_t identity_path()
+        {
+            path_t path;
+            for (unsigned idx = 0; idx < NumUnsafeDropStates; ++idx)
+            {
+                path[idx] = idx;
+            }
+            return path;
+        }
+
+        // the states at the query of the given states at a program point
+        UnsafeDropStateSet through(const path_t &Path, UnsafeDropStateSet States)
+        {
+            UnsafeDropStateSet mapped;
+            States.forEach([&](UnsafeDropState S)
+                           { mapped.insert(state_from_index(Path[state_index(S)])); });
+            return mapped;
+        }
+
+        // the states only reached through a DROP or UNSAFE_CONSTRUCT transition
+        constexpr UnsafeDropStateSet ReleasedStates = {UnsafeDropState::DROPPED, UnsafeDropState::RAW_WRAPPED,
+                                                       UnsafeDropState::UAF_ERROR, UnsafeDropState::DF_ERROR};
+
+        bool is_seed_token(UnsafeDropToken Token)
+        {
+            return Token == UnsafeDropToken::DROP || Token == UnsafeDropToken::UNSAFE_CONSTRUCT;
+        }
+
+        /**
+         * The backward walks of the queries of one function. The states of a value
+         * at the end of a block are solved on demand, together with the ones at
+         * the ends of the blocks they depend on, and kept for the later queries.
+         */
+        class FunctionQueries
+        {
+        private:
+            HelperAnalyses &HA;
+            const BitVectorEngine &Callees;
+            const transition_table_t &Transitions;
+            const UnsafeDropState Start;
+            const UnsafeDropState Uninit;
+
+            // what walking backwards from a point of a block to its entry finds out about a value: the states it
+            // is given on the way, already mapped to the point, and the values whose states at the block entry
+            // flow into it with the transitions of the calls in between
+            struct Segment
+            {
+                UnsafeDropStateSet States;
+                llvm::SmallVector<std::pair<const llvm::Value *, path_t>, 2> Entries;
+            };
+            struct Node
+            {
+                Segment Seg;
+                // the states of the value at the end of the block
+                UnsafeDropStateSet States;
+            };
+            using node_key_t = std::pair<const llvm::BasicBlock *, const llvm::Value *>;
+            // every node is solved, its dependencies are solved together with it
+            llvm::DenseMap<node_key_t, Node> Nodes;
+
+        public:
+            llvm::DenseMap<const llvm::Instruction *, CallEffect> Effects;
+            llvm::DenseMap<const llvm::Instruction *, MemoryEffect> MemoryEffects;
+            // the definitions entered at each call that has one
+            llvm::DenseMap<const llvm::Instruction *, llvm::SmallVector<const llvm::Function *, 2>> EnteredCallees;
+            // the engines ignore blocks that cannot be reached from the entry
+            llvm::DenseSet<const llvm::BasicBlock *> Reachable;
+
+            FunctionQueries(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD, const BitVectorEngine &Callees,
+                            bool UnsafeConstructAsFactory, const llvm::Function &F)
+                : HA(HA), Callees(Callees), Transitions(UnsafeDropTransitions[UnsafeConstructAsFactory]),
+                  Start(TSD.start()), Uninit(TSD.uninit()),
+                  Effects(call_effects(HA, TSD, F)), MemoryEffects(memory_effects(HA, F))
+            {
+                for (const auto *BB : llvm::depth_first(&F))
+                {
+                    Reachable.insert(BB);
+                }
+                for (const auto &I : llvm::instructions(F))
+                {
+                    if (const auto *call = llvm::dyn_cast<llvm::CallBase>(&I))
+                    {
+                        if (auto callees = entered_callees(HA, TSD, *call); !callees.empty())
+                        {
+                            EnteredCallees[call] = std::move(callees);
+                        }
+                    }
+                }
+            }
+
+            // the states the callees entered at I return to W, joined after the call-to-return flow
+            UnsafeDropStateSet returnedStates(const llvm::Instruction &I, const llvm::Value *W) const
+            {
+                auto it = EnteredCallees.find(&I);
+                if (it == EnteredCallees.end())
+                {
+                    return {};
+                }
+                const auto &call = llvm::cast<llvm::CallBase>(I);
+                UnsafeDropStateSet states;
+                for (const auto *callee : it->second)
+                {
+                    const auto &summary = Callees.summaryOf(*callee);
+                    if (W == &call)
+                    {
+                        states |= UnsafeDropStateSet::fromMask(summary.Ret);
+                    }
+                    for (unsigned idx = 0; idx < call.arg_size() && idx < summary.Params.size(); ++idx)
+                    {
+                        if (call.getArgOperand(idx) == W)
+                        {
+                            states |= UnsafeDropStateSet::fromMask(summary.Params[idx]);
+                        }
+                    }
+                }
+                return states;
+            }
+
+            // backwards from It to the entry of BB, following the value whose states end up in W: through the
+            // pointer operand of a load or getelementptr defining it and the stored value of a store overwriting it
+            Segment walk(const llvm::BasicBlock &BB, llvm::BasicBlock::const_reverse_iterator It, const llvm::Value *W) const
+            {
+                struct Item
+                {
+                    llvm::BasicBlock::const_reverse_iterator It;
+                    const llvm::Value *W;
+                    path_t Path;
+                };
+                Segment seg;
+                llvm::SmallVector<Item, 4> worklist = {Item{It, W, identity_path()}};
+                while (!worklist.empty())
+                {
+                    auto item = worklist.pop_back_val();
+                    bool overwritten = false;
+                    for (; item.It != BB.rend() && !overwritten; ++item.It)
+                    {
+                        const auto &I = *item.It;
+                        // generated from zero, the states of a previous loop iteration are kept
+                        if (llvm::isa<llvm::AllocaInst>(I))
+                        {
+                            if (&I == item.W)
+                            {
+                                seg.States.insert(state_from_index(item.Path[state_index(Uninit)]));
+                            }
+                            continue;
+                        }
+                        if (auto memory = MemoryEffects.find(&I); memory != MemoryEffects.end())
+                        {
+                            const auto &effect = memory->second;
+                            if (!llvm::is_contained(effect.Dsts, item.W))
+                            {
+                                continue;
+                            }
+                            if (!effect.Strong)
+                            {
+                                if (effect.Src)
+                                {
+                                    worklist.push_back(Item{std::next(item.It), effect.Src, item.Path});
+                                }
+                            }
+                            // the states of W are replaced by the ones of the stored value
+                            else if (effect.Src)
+                            {
+                                item.W = effect.Src;
+                            }
+                            else
+                            {
+                                overwritten = true;
+                            }
+                            continue;
+                        }
+                        seg.States |= through(item.Path, returnedStates(I, item.W));
+                        auto call = Effects.find(&I);
+                        if (call == Effects.end())
+                        {
+                            continue;
+                        }
+                        if (llvm::is_contained(call->second.Starts, item.W))
+                        {
+                            seg.States.insert(state_from_index(item.Path[state_index(Start)]));
+                        }
+                        else if (llvm::is_contained(call->second.Consumed, item.W))
+                        {
+                            const auto &row = Transitions[token_index(call->second.Token)];
+                            path_t composed;
+                            for (unsigned idx = 0; idx < NumUnsafeDropStates; ++idx)
+                            {
+                                composed[idx] = item.Path[state_index(row[idx])];
+                            }
+                            item.Path = composed;
+                        }
+                    }
+                    const auto entry = std::make_pair(item.W, item.Path);
+                    if (!overwritten && !llvm::is_contained(seg.Entries, entry))
+                    {
+                        seg.Entries.push_back(entry);
+                    }
+                }
+                return seg;
+            }
+
+            // the states of Seg with the ones of its entries taken from the ends of the predecessors of BB
+            UnsafeDropStateSet evaluate(const llvm::BasicBlock &BB, const Segment &Seg) const
+            {
+                auto states = Seg.States;
+                for (const auto &[W, path] : Seg.Entries)
+                {
+                    UnsafeDropStateSet entry_states;
+                    for (const auto *pred : llvm::predecessors(&BB))
+                    {
+                        if (auto it = Nodes.find({pred, W}); it != Nodes.end())
+                        {
+                            entry_states |= it->second.States;
+                        }
+                    }
+                    states |= through(path, entry_states);
+                }
+                return states;
+            }
+
+            // make sure the states at the entry of BB are solved for the entries of Seg, counts the pairs solved
+            void solveEntries(const llvm::BasicBlock &BB, const Segment &Seg, size_t &NumSolved)
+            {
+                // the pairs without states yet, depth first
+                std::vector<node_key_t> discovered;
+                llvm::SmallVector<node_key_t, 16> stack;
+                auto push_preds = [&](const llvm::BasicBlock &Succ, const Segment &SuccSeg)
+                {
+                    for (const auto &entry : SuccSeg.Entries)
+                    {
+                        for (const auto *pred : llvm::predecessors(&Succ))
+                        {
+                            if (Reachable.count(pred) && !Nodes.count({pred, entry.first}))
+                            {
+                                stack.push_back({pred, entry.first});
+                            }
+                        }
+                    }
+                };
+                push_preds(BB, Seg);
+                while (!stack.empty())
+                {
+                    const auto key = stack.pop_back_val();
+                    if (Nodes.count(key))
+                    {
+                        continue;
+                    }
+                    auto seg = walk(*key.first, key.first->rbegin(), key.second);
+                    push_preds(*key.first, seg);
+                    Nodes[key].Seg = std::move(seg);
+                    discovered.push_back(key);
+                }
+                NumSolved += discovered.size();
+
+                // the dependencies were discovered after their dependents, the states only grow, so this terminates
+                bool changed = true;
+                while (changed)
+                {
+                    changed = false;
+                    for (auto it = discovered.rbegin(); it != discovered.rend(); ++it)
+                    {
+                        const auto states = evaluate(*it->first, Nodes[*it].Seg);
+                        auto &node = Nodes[*it];
+                        if (states != node.States)
+                        {
+                            node.States = states;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+
+            DemandQuery query(const llvm::CallBase &Site, const llvm::Value *V)
+            {
+                DemandQuery query{&Site, V, {}, {}};
+                const auto seg = walk(*Site.getParent(), ++Site.getReverseIterator(), V);
+                solveEntries(*Site.getParent(), seg, query.NumVisited);
+                query.Before = evaluate(*Site.getParent(), seg);
+
+                // the effect of the site itself
+                const auto site_effect = Effects.lookup(&Site);
+                if (llvm::is_contained(site_effect.Starts, V))
+                {
+                    query.After = query.Before;
+                    query.After.insert(Start);
+                }
+                else if (llvm::is_contained(site_effect.Consumed, V))
+                {
+                    const auto &row = Transitions[token_index(site_effect.Token)];
+                    query.Before.forEach([&](UnsafeDropState S)
+                                         { query.After.insert(row[state_index(S)]); });
+                }
+                else
+                {
+                    query.After = query.Before;
+                }
+                query.After |= returnedStates(Site, V);
+                return query;
+            }
+        }; // class FunctionQueries
+    } // anonymous namespace
+
+    DemandQueryEngine::DemandQueryEngine(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD, bool UnsafeConstructAsFactory)
+        : HA(HA), TSD(TSD), UnsafeConstructAsFactory(UnsafeConstructAsFactory), Callees(HA, TSD, UnsafeConstructAsFactory)
+    {
+    }
+
+    bool DemandQueryEngine::releases(const llvm::Function &F) const
+    {
+        if (auto it = Releases.find(&F); it != Releases.end())
+        {
+            return it->second;
+        }
+        // the transitive callees of F without an answer, whether they call a DROP or UNSAFE_CONSTRUCT
+        // function themselves, and their callees
+        std::vector<const llvm::Function *> closure = {&F};
+        llvm::DenseMap<const llvm::Function *, llvm::SmallVector<const llvm::Function *, 4>> callees;
+        for (size_t i = 0; i < closure.size(); ++i)
+        {
+            const auto *G = closure[i];
+            bool releases = false;
+            auto &G_callees = callees[G];
+            for (const auto &I : llvm::instructions(*G))
+            {
+                const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+                if (!call)
+                {
+                    continue;
+                }
+                if (call->getCalledFunction() &&
+                    is_seed_token(TSD.funcNameToToken(DemangleCache::global().demangle(call->getCalledFunction()))))
+                {
+                    releases = true;
+                }
+                for (const auto *callee : entered_callees(HA, TSD, *call))
+                {
+                    G_callees.push_back(callee);
+                    if (!Releases.count(callee) && !callees.count(callee))
+                    {
+                        callees[callee];
+                        closure.push_back(callee);
+                    }
+                }
+            }
+            Releases[G] = releases;
+        }
+        // a function releases if one of its callees does, the answers only flip to true, so this terminates
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (const auto *G : closure)
+            {
+                if (!Releases[G] && llvm::any_of(callees[G], [&](const llvm::Function *Callee)
+                                                 { return Releases.lookup(Callee); }))
+                {
+                    Releases[G] = true;
+                    changed = true;
+                }
+            }
+        }
+        return Releases[&F];
+    }
+
+    std::vector<const llvm::CallBase *> DemandQueryEngine::findCandidates(llvm::ArrayRef<const llvm::Function *> Functions) const
+    {
+        std::vector<const llvm::CallBase *> candidates;
+        for (const auto *F : Functions)
+        {
+            if (F->isDeclaration())
+            {
+                continue;
+            }
+            for (const auto &I : llvm::instructions(*F))
+            {
+                const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+                if (call && call->getCalledFunction() &&
+                    is_seed_token(TSD.funcNameToToken(DemangleCache::global().demangle(call->getCalledFunction()))))
+                {
+                    candidates.push_back(call);
+                }
+            }
+        }
+        return candidates;
+    }
+
+    std::vector<DemandQuery> DemandQueryEngine::queryAll(llvm::ArrayRef<const llvm::Function *> Functions) const
+    {
+        std::vector<DemandQuery> queries;
+        const auto candidates = findCandidates(Functions);
+        auto next_candidate = candidates.begin();
+        for (const auto *F : Functions)
+        {
+            if (F->isDeclaration())
+            {
+                continue;
+            }
+            // the candidates of a function are adjacent and in the order of the functions
+            const auto first_candidate = next_candidate;
+            while (next_candidate != candidates.end() && (*next_candidate)->getFunction() == F)
+            {
+                ++next_candidate;
+            }
+            // without a candidate, only a callee can release a value of F
+            llvm::SmallVector<const llvm::CallBase *, 8> releasing_calls;
+            for (const auto &I : llvm::instructions(*F))
+            {
+                if (const auto *call = llvm::dyn_cast<llvm::CallBase>(&I))
+                {
+                    const auto callees = entered_callees(HA, TSD, *call);
+                    if (llvm::any_of(callees, [&](const llvm::Function *Callee)
+                                     { return releases(*Callee); }))
+                    {
+                        releasing_calls.push_back(call);
+                    }
+                }
+            }
+            if (first_candidate == next_candidate && releasing_calls.empty())
+            {
+                continue;
+            }
+
+            FunctionQueries fn(HA, TSD, Callees, UnsafeConstructAsFactory, *F);
+            llvm::DenseSet<const llvm::Value *> released;
+            for (auto it = first_candidate; it != next_candidate; ++it)
+            {
+                const auto *site = *it;
+                if (!fn.Reachable.count(site->getParent()))
+                {
+                    continue;
+                }
+                const auto name = DemangleCache::global().demangle(site->getCalledFunction());
+                for (const auto *V : local_args_and_aliases(HA, *site, TSD.getConsumerParamIdx(name)))
+                {
+                    auto query = fn.query(*site, V);
+                    if ((query.Before | query.After).containsAny(ReleasedStates))
+                    {
+                        released.insert(V);
+                    }
+                    queries.push_back(query);
+                }
+            }
+            for (const auto *call : releasing_calls)
+            {
+                if (is_local_value(call, *F) && fn.returnedStates(*call, call).containsAny(ReleasedStates))
+                {
+                    released.insert(call);
+                }
+                for (const auto &arg : call->args())
+                {
+                    if (is_local_value(arg.get(), *F) && fn.returnedStates(*call, arg.get()).containsAny(ReleasedStates))
+                    {
+                        released.insert(arg.get());
+                    }
+                }
+            }
+            // the states of a released value flow on through memory
+            bool changed = true;
+            while (changed)
+            {
+                changed = false;
+                for (const auto &[inst, effect] : fn.MemoryEffects)
+                {
+                    if (!effect.Src || !released.count(effect.Src))
+                    {
+                        continue;
+                    }
+                    for (const auto *dst : effect.Dsts)
+                    {
+                        changed |= released.insert(dst).second;
+                    }
+                }
+            }
+            if (released.empty())
+            {
+                continue;
+            }
+
+            // USE and GET_PTR only turn a released value into an error
+            for (const auto &I : llvm::instructions(*F))
+            {
+                auto effect = fn.Effects.find(&I);
+                if (effect == fn.Effects.end() || !fn.Reachable.count(I.getParent()) ||
+                    (effect->second.Token != UnsafeDropToken::USE && effect->second.Token != UnsafeDropToken::GET_PTR))
+                {
+                    continue;
+                }
+                for (const auto *V : effect->second.Consumed)
+                {
+                    if (released.count(V))
+                    {
+                        queries.push_back(fn.query(llvm::cast<llvm::CallBase>(I), V));
+                    }
+                }
+            }
+        }
+        return queries;
+    }
+
+    RunResult demand_run_result(llvm::ArrayRef<DemandQuery> Queries)
+    {
+        std::vector<ResultCell> cells;
+        std::vector<value_states_t> states;
+        for (const auto &query : Queries)
+        {
+            if (!query.Before.empty())
+            {
+                states.emplace_back(query.Val, UnsafeDropStateSet{join_of(query.Before)});
+            }
+            if (!query.After.empty())
+            {
+                cells.push_back(ResultCell{query.Site, query.Val, join_of(query.After)});
+                states.emplace_back(query.Val, UnsafeDropStateSet{join_of(query.After)});
+            }
+        }
+        return RunResult(std::move(cells), std::move(states));
+    }
+
+    void print_demand_queries(llvm::ArrayRef<DemandQuery> Queries, llvm::raw_ostream &OS)
+    {
+        const UnsafeDropStateSet interesting = {UnsafeDropState::DROPPED, UnsafeDropState::RAW_WRAPPED};
+        for (const auto &query : Queries)
+        {
+            if (!query.Before.containsAny(interesting))
+            {
+                continue;
+            }
+            OS << "IR: " << *query.Site << "\n"
+               << " -> Value: " << *query.Val << "\n"
+               << "    before: " << query.Before << "\n"
+               << "    after: " << query.After << "\n";
+        }
+    }
+
+    size_t compare_demand_findings(const RunResult &IDERun, llvm::ArrayRef<DemandQuery> Queries, llvm::raw_ostream &OS)
+    {
+        // the states of each queried value, in the order of their first query
+        llvm::MapVector<const llvm::Value *, UnsafeDropStateSet> demand_states;
+        for (const auto &query : Queries)
+        {
+            auto &states = demand_states[query.Val];
+            states |= query.Before;
+            states |= query.After;
+        }
+        // the filter of the df_uaf section of the report
+        const UnsafeDropStateSet error_states = {UnsafeDropState::DF_ERROR, UnsafeDropState::UAF_ERROR};
+        auto is_finding = [&](UnsafeDropStateSet States)
+        {
+            return is_informative(States) && States.containsAny(error_states);
+        };
+        size_t num_differences = 0;
+        for (const auto &[V, states] : demand_states)
+        {
+            const auto ide_states = IDERun.statesOf(V);
+            if (is_finding(ide_states) != is_finding(states))
+            {
+                ++num_differences;
+                OS << *V << " ==> finding only in " << (is_finding(ide_states) ? "ide: " : "demand: ")
+                   << ide_states << " vs " << states << "\n";
+            }
+        }
+        return num_differences;
+    }
+
+} // namespace psr
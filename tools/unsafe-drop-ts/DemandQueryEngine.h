@@ -0,0 +1,110 @@
+#ifndef DEMAND_QUERY_ENGINE_H
+#define DEMAND_QUERY_ENGINE_H
+
+#include "phasar.h"
+#include "BitVectorEngine.h"
+#include "RunResult.h"
+#include "UnsafeDropStateDescription.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * The answer to "which states can Val be in at Site?".
+     */
+    struct DemandQuery
+    {
+        // a DROP or UNSAFE_CONSTRUCT call, or a USE or GET_PTR call of a value that may be released there
+        const llvm::CallBase *Site;
+        // an argument of Site or one of its aliases
+        const llvm::Value *Val;
+        // the states Val can be in right before and right after Site
+        UnsafeDropStateSet Before;
+        UnsafeDropStateSet After;
+        // the number of (block, value) pairs the query had to solve, pairs solved by earlier queries are reused
+        size_t NumVisited = 0;
+    };
+
+    /**
+     * Demand-driven solver for UnsafeDropStateDescription, an alternative to
+     * solving UnsafeDropTypeStateAnalysis exhaustively.
+     *
+     * Only a DROP transition leads to DROPPED and only an UNSAFE_CONSTRUCT
+     * transition to RAW_WRAPPED, and a DF or UAF error needs a DROPPED value.
+     * The queries are therefore seeded at the DROP and UNSAFE_CONSTRUCT call
+     * sites, found by classifying the call sites only, for every consumed
+     * argument and its aliases. A USE or GET_PTR call site is only queried for
+     * the values that may be released: those found DROPPED, RAW_WRAPPED or in
+     * an error state by the seeded queries, the values a callee may return
+     * released, and the values loaded, offset or stored from any of them.
+     *
+     * A query walks the CFG of its function backwards and collects the allocas
+     * and factory calls that give the value a state, composing the transitions
+     * of the calls passed on the way. Where a load or getelementptr defines the
+     * value or a store overwrites it, the walk continues with the value whose
+     * states flow into it, see MemoryEffect. The states of a value at the end of
+     * a block are solved once, together with the blocks they depend on, and
+     * shared by all queries of the function.
+     *
+     * The IDE solver enters callees with the zero fact and returns the states
+     * of their return value and parameters to the call site. The walk takes
+     * them from the CalleeSummary of the bit-vector engine, which is only
+     * computed for the callees it passes. A callee whose calls cannot reach a
+     * DROP or UNSAFE_CONSTRUCT call cannot release anything and is not solved
+     * to find the values to query. So each answer is the mask the bit-vector
+     * engine holds for the value at that point. Values that are never queried
+     * have no results; --engine all compares the findings of the queried values
+     * with the IDE run.
+     */
+    class DemandQueryEngine
+    {
+    private:
+        HelperAnalyses &HA;
+        const UnsafeDropStateDescription &TSD;
+        bool UnsafeConstructAsFactory;
+        // the callee summaries, computed on first use
+        BitVectorEngine Callees;
+        // whether a function transitively calls a DROP or UNSAFE_CONSTRUCT function
+        mutable llvm::DenseMap<const llvm::Function *, bool> Releases;
+
+        [[nodiscard]] bool releases(const llvm::Function &F) const;
+
+    public:
+        DemandQueryEngine(HelperAnalyses &HA, const UnsafeDropStateDescription &TSD, bool UnsafeConstructAsFactory);
+
+        // the DROP and UNSAFE_CONSTRUCT call sites in the given function definitions, where the queries start
+        [[nodiscard]] std::vector<const llvm::CallBase *> findCandidates(llvm::ArrayRef<const llvm::Function *> Functions) const;
+
+        // answer the queries at all candidates in Functions and at the USE and GET_PTR sites of released values
+        [[nodiscard]] std::vector<DemandQuery> queryAll(llvm::ArrayRef<const llvm::Function *> Functions) const;
+    }; // class DemandQueryEngine
+
+    /**
+     * The answers of DemandQueryEngine::queryAll as a run result: one cell per
+     * query at its candidate with the join of the states after it. The states
+     * of a value are the joins before and after each of its candidates, other
+     * instructions and values have no results.
+     */
+    RunResult demand_run_result(llvm::ArrayRef<DemandQuery> Queries);
+
+    // the queries whose value can be DROPPED or RAW_WRAPPED at their candidate
+    void print_demand_queries(llvm::ArrayRef<DemandQuery> Queries, llvm::raw_ostream &OS);
+
+    /**
+     * Print every queried value that is a DF/UAF finding in only one of the IDE
+     * run and the answers, returns the number of such values. Values without
+     * queries are not compared, the demand engine has no results for them.
+     */
+    size_t compare_demand_findings(const RunResult &IDERun, llvm::ArrayRef<DemandQuery> Queries, llvm::raw_ostream &OS);
+
+} // namespace psr
+
+#endif // DEMAND_QUERY_ENGINE_H
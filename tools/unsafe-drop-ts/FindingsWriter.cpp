@@ -0,0 +1,158 @@
+#include "FindingsWriter.h"
+
+#include <algorithm>
+#include <tuple>
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "phasar/PhasarLLVM/Utils/LLVMIRToSrc.h"
+#include "phasar/Utils/Logger.h"
+
+namespace psr
+{
+
+    namespace
+    {
+        std::string ir_string(const llvm::Value *V)
+        {
+            std::string str;
+            llvm::raw_string_ostream OS(str);
+            OS << *V;
+            return llvm::StringRef(OS.str()).trim().str();
+        }
+
+        struct SourceLocation
+        {
+            std::string file;
+            unsigned line;
+            unsigned column;
+            std::string function;
+            std::string ir;
+
+            explicit SourceLocation(const llvm::Value *V)
+                : file(getFilePathFromIR(V)),
+                  line(getLineFromIR(V)),
+                  column(getColumnFromIR(V)),
+                  function(getFunctionNameFromIR(V)),
+                  ir(ir_string(V)) {}
+
+            bool operator<(const SourceLocation &Other) const
+            {
+                return std::tie(file, line, column, function, ir) <
+                       std::tie(Other.file, Other.line, Other.column, Other.function, Other.ir);
+            }
+        };
+
+        void write_location(llvm::json::OStream &J, const SourceLocation &Loc)
+        {
+            J.attribute("function", Loc.function);
+            J.attribute("file", Loc.file);
+            J.attribute("line", Loc.line);
+            J.attribute("column", Loc.column);
+            J.attribute("ir", Loc.ir);
+        }
+
+        void write_finding(llvm::raw_ostream &OS, llvm::StringRef Kind, const SourceLocation &Loc,
+                           UnsafeDropStateSet States, const SourceLocation *At)
+        {
+            llvm::json::OStream J(OS);
+            J.object([&]
+                     {
+                         J.attribute("kind", Kind);
+                         J.attributeArray("states", [&]
+                                          { States.forEach([&](UnsafeDropState S)
+                                                           { J.value(to_string(S).split("::").second); }); });
+                         write_location(J, Loc);
+                         if (At)
+                         {
+                             J.attributeObject("at", [&]
+                                               { write_location(J, *At); });
+                         } });
+            OS << "\n";
+            OS.flush();
+        }
+    } // anonymous namespace
+
+    FindingsWriter::FindingsWriter(const std::string &Path)
+    {
+        if (Path.empty())
+        {
+            return;
+        }
+        if (Path == "-")
+        {
+            PHASAR_LOG_LEVEL(ERROR, "Findings cannot be written to stdout, the report is printed there");
+            return;
+        }
+        std::error_code ec;
+        this->OS = std::make_unique<llvm::raw_fd_ostream>(Path, ec, llvm::sys::fs::OF_Text);
+        if (ec)
+        {
+            PHASAR_LOG_LEVEL(ERROR, "Could not open findings file " << Path << ": " << ec.message());
+            this->OS.reset();
+        }
+    }
+
+    void FindingsWriter::write(llvm::StringRef Kind, const llvm::Value *V, UnsafeDropStateSet States,
+                               const llvm::Instruction *At)
+    {
+        if (!this->enabled())
+        {
+            return;
+        }
+        if (At)
+        {
+            const SourceLocation at(At);
+            write_finding(*this->OS, Kind, SourceLocation(V), States, &at);
+        }
+        else
+        {
+            write_finding(*this->OS, Kind, SourceLocation(V), States, nullptr);
+        }
+        ++this->NumFindings;
+    }
+
+    void FindingsWriter::writeSection(llvm::StringRef Kind, llvm::ArrayRef<value_states_t> Findings)
+    {
+        if (!this->enabled())
+        {
+            return;
+        }
+        std::vector<std::pair<SourceLocation, UnsafeDropStateSet>> located;
+        located.reserve(Findings.size());
+        for (const auto &[llvm_value, states] : Findings)
+        {
+            located.emplace_back(SourceLocation(llvm_value), states);
+        }
+        std::stable_sort(located.begin(), located.end(),
+                         [](const auto &L, const auto &R)
+                         { return L.first < R.first; });
+        for (const auto &[loc, states] : located)
+        {
+            write_finding(*this->OS, Kind, loc, states, nullptr);
+            ++this->NumFindings;
+        }
+    }
+
+    void FindingsWriter::writeSection(llvm::StringRef Kind, llvm::ArrayRef<FindingAt> Findings)
+    {
+        if (!this->enabled())
+        {
+            return;
+        }
+        std::vector<std::tuple<SourceLocation, SourceLocation, UnsafeDropStateSet>> located;
+        located.reserve(Findings.size());
+        for (const auto &finding : Findings)
+        {
+            located.emplace_back(SourceLocation(finding.Val), SourceLocation(finding.At), finding.States);
+        }
+        std::stable_sort(located.begin(), located.end(),
+                         [](const auto &L, const auto &R)
+                         { return std::tie(std::get<0>(L), std::get<1>(L)) < std::tie(std::get<0>(R), std::get<1>(R)); });
+        for (const auto &[loc, at, states] : located)
+        {
+            write_finding(*this->OS, Kind, loc, states, &at);
+            ++this->NumFindings;
+        }
+    }
+
+} // namespace psr
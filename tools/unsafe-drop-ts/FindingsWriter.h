@@ -0,0 +1,63 @@
+#ifndef FINDINGS_WRITER_H
+#define FINDINGS_WRITER_H
+
+#include <memory>
+#include <string>
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Value.h"
+#include "llvm/Support/raw_ostream.h"
+#include "RunResult.h"
+#include "UnsafeDropStateDescription.h"
+
+namespace psr
+{
+
+    // a finding of a value at the instruction it was detected at
+    struct FindingAt
+    {
+        const llvm::Value *Val;
+        UnsafeDropStateSet States;
+        const llvm::Instruction *At;
+    };
+
+    /**
+     * Streaming writer for DF/UAF findings in JSON Lines format.
+     *
+     * Each finding is written and flushed as one line as soon as it is known,
+     * with the source location of the value taken from the debug information.
+     * Nothing but the findings of the current report section is kept in memory.
+     * Within a section the findings are ordered by source location and IR text,
+     * so that the output of two runs can be diffed.
+     */
+    class FindingsWriter
+    {
+    private:
+        std::unique_ptr<llvm::raw_fd_ostream> OS;
+        size_t NumFindings = 0;
+
+    public:
+        /**
+         * Open the findings file at Path. An empty Path disables the writer,
+         * so does "-", stdout is taken by the text report.
+         */
+        explicit FindingsWriter(const std::string &Path);
+
+        [[nodiscard]] bool enabled() const { return OS != nullptr; }
+        [[nodiscard]] size_t numFindings() const { return NumFindings; }
+
+        // write a single finding of a value, optionally at the instruction it was detected at
+        void write(llvm::StringRef Kind, const llvm::Value *V, UnsafeDropStateSet States,
+                   const llvm::Instruction *At = nullptr);
+
+        // write all findings of a report section, ordered by source location
+        void writeSection(llvm::StringRef Kind, llvm::ArrayRef<value_states_t> Findings);
+
+        // write all findings of a report section, ordered by the source location of the value, then of the instruction
+        void writeSection(llvm::StringRef Kind, llvm::ArrayRef<FindingAt> Findings);
+    }; // class FindingsWriter
+
+} // namespace psr
+
+#endif // FINDINGS_WRITER_H
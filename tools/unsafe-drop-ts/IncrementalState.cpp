@@ -0,0 +1,337 @@
+#include "IncrementalState.h"
+#include "FunctionFingerprint.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+#include <optional>
+
+namespace psr
+{
+
+    namespace
+    {
+
+        // bump whenever the layout or the meaning of the state file changes
+        constexpr int64_t StateFileVersion = 2;
+
+        // index of every instruction within its function, for the functions of the results,
+        // debug intrinsics are not numbered, like in the fingerprint
+        using inst_index_t = llvm::DenseMap<const llvm::Instruction *, unsigned>;
+
+        void index_function(const llvm::Function &F, inst_index_t &Index)
+        {
+            unsigned idx = 0;
+            for (const auto *I : fingerprinted_instructions(F))
+            {
+                Index[I] = idx++;
+            }
+        }
+
+        // reference to V relative to F: "a<arg no>", "i<instruction index>" or "g<global name>"
+        std::optional<std::string> value_ref(const llvm::Function &F, const llvm::Value *V, const inst_index_t &Index)
+        {
+            if (const auto *A = llvm::dyn_cast<llvm::Argument>(V))
+            {
+                if (A->getParent() == &F)
+                {
+                    return "a" + std::to_string(A->getArgNo());
+                }
+            }
+            else if (const auto *I = llvm::dyn_cast<llvm::Instruction>(V))
+            {
+                auto it = Index.find(I);
+                if (I->getFunction() == &F && it != Index.end())
+                {
+                    return "i" + std::to_string(it->second);
+                }
+            }
+            else if (const auto *G = llvm::dyn_cast<llvm::GlobalValue>(V))
+            {
+                if (G->hasName())
+                {
+                    return "g" + G->getName().str();
+                }
+            }
+            return std::nullopt;
+        }
+
+        const llvm::Value *resolve_value_ref(const llvm::Function &F, llvm::StringRef Ref,
+                                             llvm::ArrayRef<const llvm::Instruction *> Insts)
+        {
+            if (Ref.empty())
+            {
+                return nullptr;
+            }
+            const char kind = Ref.front();
+            Ref = Ref.drop_front();
+            if (kind == 'g')
+            {
+                return F.getParent()->getNamedValue(Ref);
+            }
+            unsigned idx = 0;
+            if (Ref.getAsInteger(10, idx))
+            {
+                return nullptr;
+            }
+            if (kind == 'a')
+            {
+                return idx < F.arg_size() ? F.getArg(idx) : nullptr;
+            }
+            if (kind == 'i')
+            {
+                return idx < Insts.size() ? Insts[idx] : nullptr;
+            }
+            return nullptr;
+        }
+
+    } // anonymous namespace
+
+    IncrementalState::IncrementalState(std::string Path, HelperAnalyses &HA, llvm::ArrayRef<const llvm::Function *> Functions, unsigned NumRuns)
+        : Path(std::move(Path)), IRDB(HA.getProjectIRDB())
+    {
+        for (const auto *F : Functions)
+        {
+            if (!F->isDeclaration())
+            {
+                Fingerprints[F->getName()] = llvm::utohexstr(function_fingerprint(*F));
+            }
+        }
+
+        load(NumRuns);
+
+        auto add_affected = [this](llvm::StringRef Name)
+        {
+            if (AffectedSet.insert(Name).second)
+            {
+                Affected.push_back(Name.str());
+            }
+        };
+        // the callers get the states of a callee's return value and pointer parameters through the
+        // return flow, so every function that reaches a changed function through calls is affected,
+        // the walk also passes through callers that are not tracked
+        llvm::SmallVector<const llvm::Function *, 16> worklist;
+        llvm::DenseSet<const llvm::Function *> reached;
+        for (const auto &fingerprint : Fingerprints)
+        {
+            auto prev = Previous.find(fingerprint.getKey());
+            if (prev != Previous.end() && prev->getValue().Fingerprint == fingerprint.getValue())
+            {
+                continue;
+            }
+            const auto *F = IRDB.getFunctionDefinition(fingerprint.getKey());
+            if (reached.insert(F).second)
+            {
+                worklist.push_back(F);
+            }
+        }
+        while (!worklist.empty())
+        {
+            const auto *F = worklist.pop_back_val();
+            if (Fingerprints.count(F->getName()))
+            {
+                add_affected(F->getName());
+            }
+            for (const auto *call_site : HA.getICFG().getCallersOf(F))
+            {
+                const auto *caller = call_site->getFunction();
+                if (reached.insert(caller).second)
+                {
+                    worklist.push_back(caller);
+                }
+            }
+        }
+        std::sort(Affected.begin(), Affected.end());
+    }
+
+    void IncrementalState::load(unsigned NumRuns)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(Path);
+        if (!buffer)
+        {
+            return;
+        }
+        auto json = llvm::json::parse((*buffer)->getBuffer());
+        if (!json)
+        {
+            PHASAR_LOG_LEVEL(WARNING, "incremental: ignoring unreadable state file " << Path << ": " << llvm::toString(json.takeError()));
+            return;
+        }
+        const auto *root = json->getAsObject();
+        if (!root || root->getInteger("version") != StateFileVersion || !root->getObject("functions"))
+        {
+            PHASAR_LOG_LEVEL(WARNING, "incremental: ignoring state file " << Path << " of a different version");
+            return;
+        }
+        for (const auto &[name, value] : *root->getObject("functions"))
+        {
+            const auto *entry = value.getAsObject();
+            if (!entry)
+            {
+                continue;
+            }
+            const auto fingerprint = entry->getString("fingerprint");
+            const auto *runs = entry->getArray("runs");
+            if (!fingerprint || !runs || runs->size() != NumRuns)
+            {
+                continue;
+            }
+            auto &prev = Previous[name];
+            prev.Fingerprint = fingerprint->str();
+            prev.Runs.assign(runs->begin(), runs->end());
+        }
+    }
+
+    void IncrementalState::restoreRun(const llvm::Function &F, const llvm::json::Value &Summary,
+                                      std::vector<ResultCell> &Cells, std::vector<value_states_t> &States) const
+    {
+        const auto *cells = Summary.getAsArray();
+        if (!cells)
+        {
+            return;
+        }
+        const auto insts = fingerprinted_instructions(F);
+        for (const auto &cell : *cells)
+        {
+            // [instruction index, value ref, state index]
+            const auto *fields = cell.getAsArray();
+            if (!fields || fields->size() != 3)
+            {
+                continue;
+            }
+            const auto inst_idx = (*fields)[0].getAsInteger();
+            const auto ref = (*fields)[1].getAsString();
+            const auto state_idx = (*fields)[2].getAsInteger();
+            if (!inst_idx || !ref || !state_idx ||
+                *inst_idx < 0 || *inst_idx >= static_cast<int64_t>(insts.size()) ||
+                *state_idx < 0 || *state_idx >= static_cast<int64_t>(NumUnsafeDropStates))
+            {
+                continue;
+            }
+            const auto *V = resolve_value_ref(F, *ref, insts);
+            if (!V)
+            {
+                continue;
+            }
+            const auto state = state_from_index(*state_idx);
+            Cells.push_back(ResultCell{insts[*inst_idx], V, state});
+            States.emplace_back(V, UnsafeDropStateSet{state});
+        }
+    }
+
+    RunResult IncrementalState::withReusedResults(unsigned RunIdx, const RunResult &Fresh) const
+    {
+        std::vector<ResultCell> cells(Fresh.cells().begin(), Fresh.cells().end());
+        std::vector<value_states_t> states(Fresh.states().begin(), Fresh.states().end());
+        // callees of the affected functions are solved again when the solver enters them
+        llvm::DenseSet<const llvm::Function *> solved;
+        for (const auto &cell : Fresh.cells())
+        {
+            solved.insert(cell.Inst->getFunction());
+        }
+        for (const auto &prev : Previous)
+        {
+            if (AffectedSet.count(prev.getKey()) || !Fingerprints.count(prev.getKey()))
+            {
+                continue;
+            }
+            const auto *F = IRDB.getFunctionDefinition(prev.getKey());
+            if (solved.count(F))
+            {
+                continue;
+            }
+            restoreRun(*F, prev.getValue().Runs[RunIdx], cells, states);
+        }
+        return RunResult(std::move(cells), std::move(states));
+    }
+
+    bool IncrementalState::save(llvm::ArrayRef<const RunResult *> Runs) const
+    {
+        // cells of each run grouped by function
+        using fn_cells_t = llvm::DenseMap<const llvm::Function *, std::vector<ResultCell>>;
+        std::vector<fn_cells_t> cells_by_fn(Runs.size());
+        inst_index_t inst_index;
+        llvm::DenseSet<const llvm::Function *> indexed_fns;
+        for (size_t r = 0; r < Runs.size(); ++r)
+        {
+            for (const auto &cell : Runs[r]->cells())
+            {
+                const auto *F = cell.Inst->getFunction();
+                if (indexed_fns.insert(F).second)
+                {
+                    index_function(*F, inst_index);
+                }
+                cells_by_fn[r][F].push_back(cell);
+            }
+        }
+        const std::vector<ResultCell> no_cells;
+
+        const std::string tmp_path = Path + ".tmp";
+        std::error_code ec;
+        {
+            llvm::raw_fd_ostream OS(tmp_path, ec, llvm::sys::fs::OF_Text);
+            if (ec)
+            {
+                return false;
+            }
+            llvm::json::OStream J(OS);
+            J.object([&]
+                     {
+                J.attribute("version", StateFileVersion);
+                J.attributeObject("functions", [&]
+                                  {
+                    for (const auto &fingerprint : Fingerprints)
+                    {
+                        const auto *F = IRDB.getFunctionDefinition(fingerprint.getKey());
+                        J.attributeObject(F->getName(), [&]
+                                          {
+                            J.attribute("fingerprint", fingerprint.getValue());
+                            J.attributeArray("runs", [&]
+                                             {
+                                for (const auto &fn_cells_of_run : cells_by_fn)
+                                {
+                                    const auto it = fn_cells_of_run.find(F);
+                                    const auto &fn_cells = it != fn_cells_of_run.end() ? it->second : no_cells;
+                                    // only the values that may be reported are kept
+                                    llvm::DenseMap<const llvm::Value *, UnsafeDropStateSet> fn_states;
+                                    for (const auto &cell : fn_cells)
+                                    {
+                                        fn_states[cell.Val].insert(cell.State);
+                                    }
+                                    J.array([&]
+                                            {
+                                        for (const auto &cell : fn_cells)
+                                        {
+                                            if (!llvm::isa<llvm::GlobalValue>(cell.Val) &&
+                                                !fn_states[cell.Val].containsOtherThan({UnsafeDropState::BOT, UnsafeDropState::UNINIT}))
+                                            {
+                                                continue;
+                                            }
+                                            const auto ref = value_ref(*F, cell.Val, inst_index);
+                                            if (!ref || !inst_index.count(cell.Inst))
+                                            {
+                                                continue;
+                                            }
+                                            J.array([&]
+                                                    {
+                                                J.value(static_cast<int64_t>(inst_index.lookup(cell.Inst)));
+                                                J.value(*ref);
+                                                J.value(static_cast<int64_t>(state_index(cell.State))); });
+                                        } });
+                                } }); });
+                    } }); });
+            OS << "\n";
+            if (OS.has_error())
+            {
+                OS.clear_error();
+                return false;
+            }
+        }
+        return !llvm::sys::fs::rename(tmp_path, Path);
+    }
+
+} // namespace psr
@@ -0,0 +1,94 @@
+#ifndef INCREMENTAL_STATE_H
+#define INCREMENTAL_STATE_H
+
+#include "phasar.h"
+#include "RunResult.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/JSON.h"
+
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    /**
+     * Per function fingerprints and result summaries of a previous run, used to
+     * re-solve only the functions whose IR changed.
+     *
+     * The call flow of the typestate analysis kills the facts of the arguments
+     * (every function is an API function, see UnsafeDropStateDescription::isAPIFunction),
+     * but the solver still enters the callees with the zero fact, and their return
+     * flow maps the states of the return value and of pointer parameters back to the
+     * call site. The results inside a function therefore depend on its own IR and on
+     * the IR of all functions it transitively calls, but not on its callers.
+     * A function has to be solved again if its fingerprint changed or if it reaches
+     * a function whose fingerprint changed through calls, i.e. the whole reverse call
+     * graph closure of the changed functions is solved again. The results of all
+     * other functions are restored from the summaries in the state file.
+     *
+     * A summary holds the cells of the values that may be reported, i.e. the values
+     * with states beyond BOT / UNINIT in the function, and all globals. Values that
+     * only ever are BOT / UNINIT are dropped, they are neither reported nor joined
+     * with the other run, but they are also missing from --full-dump output of
+     * restored functions.
+     * Values are stored relative to their function, as argument or instruction
+     * index, and globals by name, so they can be mapped back onto a module that
+     * was parsed again.
+     */
+    class IncrementalState
+    {
+    private:
+        struct FunctionEntry
+        {
+            std::string Fingerprint;
+            // one summary per typestate run
+            std::vector<llvm::json::Value> Runs;
+        };
+
+        std::string Path;
+        LLVMProjectIRDB &IRDB;
+        llvm::StringMap<FunctionEntry> Previous;
+        llvm::StringMap<std::string> Fingerprints;
+        std::vector<std::string> Affected;
+        llvm::StringSet<> AffectedSet;
+
+        void load(unsigned NumRuns);
+        void restoreRun(const llvm::Function &F, const llvm::json::Value &Summary,
+                        std::vector<ResultCell> &Cells, std::vector<value_states_t> &States) const;
+
+    public:
+        /**
+         * Fingerprint the function definitions in Functions and compare them with
+         * the state file at Path, which holds summaries of NumRuns typestate runs.
+         * A missing or unreadable state file marks every function as affected.
+         * Functions that are not tracked are neither solved, restored nor saved,
+         * so a function entering the tracked set later is always solved.
+         */
+        IncrementalState(std::string Path, HelperAnalyses &HA, llvm::ArrayRef<const llvm::Function *> Functions, unsigned NumRuns);
+
+        // names of the functions that have to be solved again, to be used as entry points
+        [[nodiscard]] const std::vector<std::string> &affectedFunctions() const { return Affected; }
+
+        [[nodiscard]] size_t numFunctions() const { return Fingerprints.size(); }
+
+        /**
+         * Add the restored results of all functions that are not affected
+         * to the fresh results of run number RunIdx.
+         */
+        [[nodiscard]] RunResult withReusedResults(unsigned RunIdx, const RunResult &Fresh) const;
+
+        /**
+         * Write the fingerprints and the summaries of the complete runs to the
+         * state file. The file is replaced atomically.
+         * Returns false if the file could not be written.
+         */
+        bool save(llvm::ArrayRef<const RunResult *> Runs) const;
+    }; // class IncrementalState
+
+} // namespace psr
+
+#endif // INCREMENTAL_STATE_H
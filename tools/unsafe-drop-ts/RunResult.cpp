@@ -0,0 +1,119 @@
+#include "RunResult.h"
+
+#include <algorithm>
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+namespace psr
+{
+
+    namespace
+    {
+        bool value_less(const value_states_t &L, const value_states_t &R)
+        {
+            return L.first < R.first;
+        }
+
+        bool inst_less(const ResultCell &L, const ResultCell &R)
+        {
+            return L.Inst < R.Inst;
+        }
+    } // anonymous namespace
+
+    RunResult::RunResult(const ide_results_t &Results)
+    {
+        llvm::DenseMap<const llvm::Value *, UnsafeDropStateSet> states_by_value;
+        {
+            // the solver copies all cells into a temporary vector, it is dropped again at the end of this scope
+            const auto all_cells = Results.getAllResultEntries();
+            this->Cells.reserve(all_cells.size());
+            for (const auto &cell : all_cells)
+            {
+                this->Cells.push_back(ResultCell{cell.getRowKey(), cell.getColumnKey(), cell.getValue()});
+                states_by_value[cell.getColumnKey()].insert(cell.getValue());
+            }
+        }
+        std::stable_sort(this->Cells.begin(), this->Cells.end(), inst_less);
+
+        this->States.assign(states_by_value.begin(), states_by_value.end());
+        std::sort(this->States.begin(), this->States.end(), value_less);
+    }
+
+    RunResult::RunResult(std::vector<ResultCell> Cells, std::vector<value_states_t> States)
+        : Cells(std::move(Cells))
+    {
+        std::stable_sort(this->Cells.begin(), this->Cells.end(), inst_less);
+
+        std::sort(States.begin(), States.end(), value_less);
+        for (const auto &value_states : States)
+        {
+            if (!this->States.empty() && this->States.back().first == value_states.first)
+            {
+                this->States.back().second |= value_states.second;
+            }
+            else
+            {
+                this->States.push_back(value_states);
+            }
+        }
+    }
+
+    llvm::ArrayRef<ResultCell> RunResult::cellsAt(const llvm::Instruction *I) const
+    {
+        auto range = std::equal_range(this->Cells.begin(), this->Cells.end(), ResultCell{I, nullptr, UnsafeDropState::TOP}, inst_less);
+        return llvm::ArrayRef<ResultCell>(this->Cells.data() + (range.first - this->Cells.begin()), range.second - range.first);
+    }
+
+    UnsafeDropStateSet RunResult::statesOf(const llvm::Value *V) const
+    {
+        auto it = std::lower_bound(this->States.begin(), this->States.end(), value_states_t{V, {}}, value_less);
+        if (it == this->States.end() || it->first != V)
+        {
+            return {};
+        }
+        return it->second;
+    }
+
+    size_t RunResult::numFunctions() const
+    {
+        llvm::DenseSet<const llvm::Function *> functions;
+        for (const auto &cell : this->Cells)
+        {
+            functions.insert(cell.Inst->getFunction());
+        }
+        return functions.size();
+    }
+
+    bool is_informative(UnsafeDropStateSet States)
+    {
+        return !States.contains(UnsafeDropState::TS_ERROR) &&
+               States.containsOtherThan({UnsafeDropState::BOT, UnsafeDropState::UNINIT});
+    }
+
+    std::vector<value_states_t> merge_states(llvm::ArrayRef<value_states_t> L, llvm::ArrayRef<value_states_t> R)
+    {
+        std::vector<value_states_t> merged;
+        merged.reserve(std::max(L.size(), R.size()));
+        auto l = L.begin();
+        auto r = R.begin();
+        while (l != L.end() || r != R.end())
+        {
+            if (r == R.end() || (l != L.end() && l->first < r->first))
+            {
+                merged.push_back(*l++);
+            }
+            else if (l == L.end() || r->first < l->first)
+            {
+                merged.push_back(*r++);
+            }
+            else
+            {
+                merged.emplace_back(l->first, l->second | r->second);
+                ++l;
+                ++r;
+            }
+        }
+        return merged;
+    }
+
+} // namespace psr
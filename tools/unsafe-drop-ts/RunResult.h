@@ -0,0 +1,76 @@
+#ifndef RUN_RESULT_H
+#define RUN_RESULT_H
+
+#include <utility>
+#include <vector>
+#include "llvm/ADT/ArrayRef.h"
+#include "phasar.h"
+#include "UnsafeDropStateDescription.h"
+
+namespace psr
+{
+
+    using ide_results_t = SolverResults<const llvm::Instruction *, const llvm::Value *, UnsafeDropState>;
+
+    // a single value / state pair that holds at an instruction
+    struct ResultCell
+    {
+        const llvm::Instruction *Inst;
+        const llvm::Value *Val;
+        UnsafeDropState State;
+    };
+
+    using value_states_t = std::pair<const llvm::Value *, UnsafeDropStateSet>;
+
+    /**
+     * Results of one typestate run.
+     *
+     * Every result cell is stored once in a flat array sorted by instruction,
+     * and the union of the states of each value over all instructions is stored
+     * as a flat value -> bitmask table sorted by value.
+     * Filtering the values is done with mask tests on that table.
+     */
+    class RunResult
+    {
+    private:
+        std::vector<ResultCell> Cells;
+        std::vector<value_states_t> States;
+
+    public:
+        explicit RunResult(const ide_results_t &Results);
+
+        // from cells and value states collected elsewhere, duplicate values in States are joined
+        RunResult(std::vector<ResultCell> Cells, std::vector<value_states_t> States);
+
+        // all value / state pairs that hold at I
+        [[nodiscard]] llvm::ArrayRef<ResultCell> cellsAt(const llvm::Instruction *I) const;
+
+        // union of the states of V over all instructions, empty if there is no result for V
+        [[nodiscard]] UnsafeDropStateSet statesOf(const llvm::Value *V) const;
+
+        // all values with their states, sorted by value
+        [[nodiscard]] llvm::ArrayRef<value_states_t> states() const { return States; }
+
+        // all cells, sorted by instruction
+        [[nodiscard]] llvm::ArrayRef<ResultCell> cells() const { return Cells; }
+
+        [[nodiscard]] size_t numCells() const { return Cells.size(); }
+
+        // the number of functions with a cell, for an IDE run the functions the solver reached
+        [[nodiscard]] size_t numFunctions() const;
+    }; // class RunResult
+
+    /**
+     * Filter for the values worth reporting:
+     * no typestate error and more information than just BOT / UNINIT.
+     */
+    [[nodiscard]] bool is_informative(UnsafeDropStateSet States);
+
+    /**
+     * Join the states of two runs on the value, sorted by value.
+     */
+    [[nodiscard]] std::vector<value_states_t> merge_states(llvm::ArrayRef<value_states_t> L, llvm::ArrayRef<value_states_t> R);
+
+} // namespace psr
+
+#endif // RUN_RESULT_H
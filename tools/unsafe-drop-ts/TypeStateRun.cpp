@@ -0,0 +1,486 @@
+#include "TypeStateRun.h"
+#include "BitVectorEngine.h"
+#include "DemandQueryEngine.h"
+#include "FindingsWriter.h"
+#include "IncrementalState.h"
+#include "RunResult.h"
+#include "UnsafeDropStateDescription.h"
+#include "UnsafeDropTypeStateAnalysis.h"
+#include "ConcurrentHelperAnalyses.h"
+#include "DemangleCache.h"
+#include "Instrumentation.h"
+#include "StdSummaries.h"
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "llvm/Support/Format.h"
+
+#include <chrono>
+#include <future>
+#include <optional>
+
+namespace psr
+{
+
+    namespace
+    {
+        void combine_results(HelperAnalyses &HA, const RunResult &run_1, const RunResult &run_2, FindingsWriter &findings)
+        {
+            const UnsafeDropStateSet error_states = {UnsafeDropState::DF_ERROR, UnsafeDropState::UAF_ERROR};
+            const UnsafeDropStateSet wrapped_states = {UnsafeDropState::RAW_WRAPPED};
+
+            auto description = UnsafeDropStateDescription(HA);
+            // written after the scan, ordered by source location like the other sections
+            std::vector<FindingAt> combined;
+
+            // TODO: implement
+            // this should for each value that ends in a DF/UAF error state
+            // find all values that are passed into the unsafeConstruct call
+            // where the value has been tagged as coming from getPtr and therefore is also in state RAW_WRAPPED
+
+            // FIXME: is this actually the correct logic????? dont we under approximate the problem with the general approach of 2 analysis
+
+            for (const auto instr : HA.getProjectIRDB().getAllInstructions())
+            {
+
+                // get run_2 value / state pairs for each instruction, filter by DF/UAF ERROR state
+
+                // SEGFAULT happens in this method call
+                // auto res_2 = run_2.Ide_results.resultsAtInLLVMSSA(instr, true, true);
+                // avoid calling resultsAtInLLVMSSA(instr), as it segfaults
+                // maybe instead call resultAtInLLVMSSA(instr) with each of the run_2_error_values
+                // avoid calling resultAtInLLVMSSA, as it also segfaults
+
+                // NOTE: the association of facts to the instruction mithgt be of by one,
+                // as the fact only holds after the instructions that introduced it.
+
+                // get run_1 value / state pairs for each instruction, filter by RAW_WRAPPED state,
+                // and merge them with the run_2 pairs on the value.
+                // Both are looked up in the instruction index of the runs, instead of scanning all cells.
+
+                llvm::SmallVector<value_states_t, 4> joined;
+                auto join = [&joined](const llvm::Value *llvm_value, UnsafeDropState state)
+                {
+                    for (auto &j : joined)
+                    {
+                        if (j.first == llvm_value)
+                        {
+                            j.second.insert(state);
+                            return;
+                        }
+                    }
+                    joined.emplace_back(llvm_value, UnsafeDropStateSet{state});
+                };
+                for (const auto &cell : run_1.cellsAt(instr))
+                {
+                    auto value_states = run_1.statesOf(cell.Val);
+                    if (is_informative(value_states) && value_states.containsAny(wrapped_states))
+                    {
+                        join(cell.Val, cell.State);
+                    }
+                }
+                for (const auto &cell : run_2.cellsAt(instr))
+                {
+                    auto value_states = run_2.statesOf(cell.Val);
+                    if (is_informative(value_states) && value_states.containsAny(error_states))
+                    {
+                        join(cell.Val, cell.State);
+                    }
+                }
+
+                UnsafeDropStateSet all_states;
+                for (const auto &j : joined)
+                {
+                    all_states |= j.second;
+                }
+
+                // llvm::outs() << "States at instruction: " << *instr << " ==\n==> " << all_states << "\n";
+
+                // TODO: check if RAW_WRAPPED and error states exists at the same instruction of kind unsafeConstruct
+                // and RAW_WRAPPED is used as a arg
+                // FIXME: should check for arg
+
+                // TODO: do only compute when unsafeConstruct invoke or all instr
+                /*
+                if (description.funcNameToToken(DemangleCache::global().demangle(???)) != UnsafeDropToken::UNSAFE_CONSTRUCT)
+                {
+                    continue;
+                }
+                */
+
+                if (all_states.containsAny(error_states) && all_states.containsAny(wrapped_states))
+                {
+                    llvm::outs() << "\n\nPotential error detected at instruction:\n    "
+                                 << *instr
+                                 << "\n Joined states: \n    ";
+                    for (const auto &j : joined)
+                    {
+                        llvm::outs() << *j.first << " ==> " << j.second << "\n";
+                        combined.push_back(FindingAt{j.first, j.second, instr});
+                    }
+                }
+            }
+
+            findings.writeSection("combined", combined);
+
+            return;
+        }
+
+        double elapsed_ms(std::chrono::steady_clock::time_point since)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+        }
+
+        RunResult run_analysis_once(HelperAnalyses &HA, const std::vector<std::string> &entrypoints, const bool unsafe_construct_as_factory, const bool analyze_std, const Engine engine, const bool debug_log, const bool full_dump, llvm::raw_ostream &OS)
+        {
+
+            if (entrypoints.empty())
+            {
+                OS << "No functions to solve\n";
+                return RunResult({}, {});
+            }
+
+            OS << "Creating problem description and solver\n";
+            const auto ts_description = UnsafeDropStateDescription(HA, unsafe_construct_as_factory, !analyze_std);
+            const std::string run_name = unsafe_construct_as_factory ? "run_2" : "run_1";
+            auto &instrumentation = Instrumentation::global();
+
+            std::optional<RunResult> ide_run;
+            double ide_ms = 0;
+            if (engine == Engine::IDE || engine == Engine::BOTH || engine == Engine::ALL)
+            {
+                auto phase = instrumentation.phase(run_name + "/ide_solve");
+                const auto start = std::chrono::steady_clock::now();
+                auto ide_ts_problem = createAnalysisProblem<UnsafeDropTypeStateAnalysis>(HA, &ts_description, entrypoints);
+                auto ide_solver = IDESolver(ide_ts_problem, &HA.getICFG());
+                OS << "Solving IDE problem\n";
+                auto ide_results = ide_solver.solve();
+                ide_run.emplace(ide_results);
+                ide_ms = elapsed_ms(start);
+                OS << "IDE solver reached " << ide_run->numFunctions() << " functions, "
+                   << ide_ts_problem.numSummarizedCalls() << " calls into std summarized\n";
+                OS << "IDE results:\n\n";
+                if (full_dump)
+                {
+                    ide_results.dumpResults(HA.getICFG(), OS);
+                }
+                else
+                {
+                    OS << "(IDE results skipped)\n";
+                }
+                if (debug_log)
+                {
+                    ide_ts_problem.printEdgeFunctionStats(OS);
+                }
+                instrumentation.setCounter(run_name + ".ide.edge_function_queries", ide_ts_problem.numEdgeFunctionQueries());
+                instrumentation.setCounter(run_name + ".ide.distinct_edge_functions", ide_ts_problem.transfers().size());
+                instrumentation.setCounter(run_name + ".ide.compose_join_memo_hits", ide_ts_problem.transfers().memoHits());
+                instrumentation.setCounter(run_name + ".ide.compose_join_memo_misses", ide_ts_problem.transfers().memoMisses());
+                instrumentation.setCounter(run_name + ".ide.result_cells", ide_run->numCells());
+                instrumentation.setCounter(run_name + ".ide.solved_functions", ide_run->numFunctions());
+                instrumentation.setCounter(run_name + ".ide.summarized_std_calls", ide_ts_problem.numSummarizedCalls());
+            }
+
+            std::optional<RunResult> bitvector_run;
+            double bitvector_ms = 0;
+            if (engine == Engine::BITVECTOR || engine == Engine::BOTH || engine == Engine::ALL)
+            {
+                auto phase = instrumentation.phase(run_name + "/bitvector_solve");
+                const auto start = std::chrono::steady_clock::now();
+                OS << "Solving with the bit-vector engine\n";
+                bitvector_run.emplace(BitVectorEngine(HA, ts_description, unsafe_construct_as_factory).solve(entry_functions(HA, entrypoints)));
+                bitvector_ms = elapsed_ms(start);
+                instrumentation.setCounter(run_name + ".bitvector.result_cells", bitvector_run->numCells());
+            }
+
+            std::optional<RunResult> demand_run;
+            std::vector<DemandQuery> queries;
+            if (engine == Engine::DEMAND || engine == Engine::ALL)
+            {
+                auto phase = instrumentation.phase(run_name + "/demand_solve");
+                OS << "Answering demand queries at the drop and unsafe construct call sites\n";
+                queries = DemandQueryEngine(HA, ts_description, unsafe_construct_as_factory).queryAll(entry_functions(HA, entrypoints));
+                size_t num_solved = 0;
+                for (const auto &query : queries)
+                {
+                    num_solved += query.NumVisited;
+                }
+                OS << queries.size() << " queries, " << num_solved << " (block, value) pairs solved\n"
+                   << "Arguments that can be DROPPED or RAW_WRAPPED at their call site:\n";
+                print_demand_queries(queries, OS);
+                demand_run.emplace(demand_run_result(queries));
+                instrumentation.setCounter(run_name + ".demand.queries", queries.size());
+                instrumentation.setCounter(run_name + ".demand.solved_pairs", num_solved);
+                instrumentation.setCounter(run_name + ".demand.result_cells", demand_run->numCells());
+            }
+
+            if (debug_log)
+            {
+                ts_description.printCacheStats(OS);
+            }
+
+            if (engine == Engine::BOTH || engine == Engine::ALL)
+            {
+                OS << "IDE solve: " << llvm::format("%.1f", ide_ms) << " ms, bit-vector solve: " << llvm::format("%.1f", bitvector_ms) << " ms\n";
+                OS << "Differences between the IDE and bit-vector results:\n";
+                const auto num_differences = compare_runs(*ide_run, *bitvector_run, OS);
+                OS << num_differences << " values with differing states\n";
+                instrumentation.setCounter(run_name + ".engine_differences", num_differences);
+                OS << "DF/UAF findings of only one engine:\n";
+                const auto num_finding_differences = compare_findings(*ide_run, *bitvector_run, OS);
+                OS << num_finding_differences << " values with differing DF/UAF findings\n";
+                instrumentation.setCounter(run_name + ".engine_finding_differences", num_finding_differences);
+            }
+            if (engine == Engine::ALL)
+            {
+                OS << "DF/UAF findings of only one of the IDE run and the demand answers:\n";
+                const auto num_finding_differences = compare_demand_findings(*ide_run, queries, OS);
+                OS << num_finding_differences << " values with differing DF/UAF findings\n";
+                instrumentation.setCounter(run_name + ".demand_finding_differences", num_finding_differences);
+            }
+
+            OS << "Collected results:\n\n";
+
+            // the IDE results stay authoritative when several engines ran
+            auto run_result = ide_run ? std::move(*ide_run) : bitvector_run ? std::move(*bitvector_run) : std::move(*demand_run);
+            instrumentation.setCounter(run_name + ".values", run_result.states().size());
+
+            if (full_dump)
+            {
+                for (const auto &[llvm_value, states] : run_result.states())
+                {
+                    OS << *llvm_value << " ==> " << states << "\n";
+                }
+            }
+            else
+            {
+                OS << "(" << run_result.states().size() << " values, " << run_result.numCells() << " cells, use --full-dump to print them)\n";
+            }
+
+            return run_result;
+        }
+
+        void print_run_result(const RunResult &run_result, llvm::raw_ostream &OS)
+        {
+            OS << "\n\n###########\n\nFiltered run results:\n\n";
+            for (const auto &[llvm_value, states] : run_result.states())
+            {
+                if (is_informative(states))
+                {
+                    OS << *llvm_value << " ==> " << states << "\n";
+                }
+            }
+        }
+
+        RunResult run_and_report(HelperAnalyses &HA, const std::vector<std::string> &entrypoints, const bool unsafe_construct_as_factory, const TypeStateOptions &Opts, llvm::raw_ostream &OS)
+        {
+            OS << "\n\n###########\n\n "
+               << (unsafe_construct_as_factory ? "Second" : "First")
+               << " Run (unsafe_construct_as_factory=" << (unsafe_construct_as_factory ? "true" : "false") << "):\n\n";
+            auto run = run_analysis_once(HA, entrypoints, unsafe_construct_as_factory, Opts.analyze_std, Opts.engine, Opts.debug_log, Opts.full_dump, OS);
+            if (Opts.full_dump)
+            {
+                print_run_result(run, OS);
+            }
+            else
+            {
+                OS << "(output skipped)\n";
+            }
+            return run;
+        }
+    } // anonymous namespace
+
+    int run_typestate(HelperAnalyses &HA, const std::vector<std::string> &EntryPoints,
+                      const TypeStateOptions &Opts, const UnsafeCode *Unsafe)
+    {
+        /* skip main check for now
+        const auto *F = HA.getProjectIRDB().getFunctionDefinition("main");
+        if (!F)
+        {
+            PHASAR_LOG_LEVEL(CRITICAL, "error: file does not contain a 'main' function!");
+            return 1;
+        }*/
+
+        // the functions whose results are wanted, all definitions unless sliced
+        std::vector<const llvm::Function *> solved_functions;
+        for (const auto *F : HA.getICFG().getAllFunctions())
+        {
+            if (!F->isDeclaration())
+            {
+                solved_functions.push_back(F);
+            }
+        }
+        std::vector<std::string> solver_entrypoints = EntryPoints;
+        if (Opts.slice_unsafe)
+        {
+            // the solvers still enter the callees of the entry points, so the solved ICFG is the slice and everything
+            // it calls: unsafe_slice already contains the transitive callees of the unsafe functions, only the other
+            // callees of their callers are solved in addition
+            auto phase = Instrumentation::global().phase("slice_unsafe");
+            std::optional<UnsafeCode> own_unsafe;
+            if (!Unsafe)
+            {
+                own_unsafe = find_unsafe_code(HA.getICFG().getAllFunctions(), Opts.debug_log ? &llvm::outs() : nullptr, Opts.cache_dir);
+                Unsafe = &*own_unsafe;
+            }
+            const auto &unsafe_functions = Unsafe->Functions;
+            const auto num_functions = solved_functions.size();
+            solved_functions = unsafe_slice(HA.getICFG(), unsafe_functions);
+            solver_entrypoints.clear();
+            for (const auto *F : solved_functions)
+            {
+                solver_entrypoints.push_back(F->getName().str());
+            }
+            llvm::outs() << "Unsafe slice: " << unsafe_functions.size() << " unsafe functions, solving "
+                         << solved_functions.size() << " of " << num_functions << " functions\n";
+        }
+
+        if (!Opts.analyze_std)
+        {
+            // calls into std are classified by their summaries and the description keeps the solvers from entering
+            // its monomorphized copies, so they are no entry points either
+            const auto num_functions = solved_functions.size();
+            llvm::erase_if(solved_functions, [](const llvm::Function *F)
+                           { return is_std_function(DemangleCache::global().demangle(F)); });
+            const auto num_skipped = num_functions - solved_functions.size();
+            if (num_skipped > 0 && (Opts.slice_unsafe || llvm::is_contained(solver_entrypoints, "__ALL__")))
+            {
+                solver_entrypoints.clear();
+                for (const auto *F : solved_functions)
+                {
+                    solver_entrypoints.push_back(F->getName().str());
+                }
+            }
+            Instrumentation::global().setCounter("typestate.std_functions_summarized", num_skipped);
+            llvm::outs() << "Summarizing " << num_skipped << " std functions at their call sites, starting from "
+                         << solved_functions.size() << " of " << num_functions << " functions\n";
+        }
+
+        // in incremental mode only the affected functions are solved, the results of all others are restored afterwards
+        std::optional<IncrementalState> incremental;
+        if (!Opts.incremental_state.empty())
+        {
+            auto phase = Instrumentation::global().phase("incremental_load");
+            incremental.emplace(Opts.incremental_state, HA, solved_functions, 2);
+            solver_entrypoints = incremental->affectedFunctions();
+            llvm::outs() << "Incremental: solving " << solver_entrypoints.size() << " of "
+                         << incremental->numFunctions() << " functions\n";
+        }
+
+        auto runs = [&]() -> std::pair<RunResult, RunResult>
+        {
+            if (!Opts.parallel_runs)
+            {
+                auto run_1 = run_and_report(HA, solver_entrypoints, false, Opts, llvm::outs());
+                auto run_2 = run_and_report(HA, solver_entrypoints, true, Opts, llvm::outs());
+                return {std::move(run_1), std::move(run_2)};
+            }
+
+            // both runs only read the shared helper analyses once they are fully built,
+            // their output is buffered and printed in the sequential order afterwards
+            llvm::outs() << "Preparing helper analyses for parallel runs\n";
+            {
+                auto phase = Instrumentation::global().phase("points_to");
+                prepare_for_concurrent_reads(HA);
+            }
+            std::string run_1_log;
+            std::string run_2_log;
+            auto run_1_future = std::async(std::launch::async, [&]
+                                           {
+                                               llvm::raw_string_ostream OS(run_1_log);
+                                               return run_and_report(HA, solver_entrypoints, false, Opts, OS); });
+            llvm::raw_string_ostream run_2_os(run_2_log);
+            auto run_2 = run_and_report(HA, solver_entrypoints, true, Opts, run_2_os);
+            auto run_1 = run_1_future.get();
+            llvm::outs() << run_1_log << run_2_os.str();
+            return {std::move(run_1), std::move(run_2)};
+        }();
+        auto &run_1 = runs.first;
+        auto &run_2 = runs.second;
+
+        if (incremental)
+        {
+            auto phase = Instrumentation::global().phase("incremental_store");
+            run_1 = incremental->withReusedResults(0, run_1);
+            run_2 = incremental->withReusedResults(1, run_2);
+            if (!incremental->save({&run_1, &run_2}))
+            {
+                PHASAR_LOG_LEVEL(WARNING, "could not write incremental state to " << Opts.incremental_state);
+            }
+        }
+
+        const UnsafeDropStateSet error_states = {UnsafeDropState::DF_ERROR, UnsafeDropState::UAF_ERROR};
+        const UnsafeDropStateSet raw_states = {UnsafeDropState::RAW_REFERENCED, UnsafeDropState::RAW_WRAPPED};
+
+        auto findings_phase = Instrumentation::global().phase("findings");
+        FindingsWriter findings(Opts.findings_file);
+
+        llvm::outs() << "\n\n###########\n\nResults with DF/UAF Errors:\n\n";
+        std::vector<value_states_t> error_findings;
+        for (const auto &[llvm_value, states] : run_2.states())
+        {
+            if (is_informative(states) && states.containsAny(error_states))
+            {
+                llvm::outs() << *llvm_value << " ==> " << states << "\n";
+                error_findings.emplace_back(llvm_value, states);
+            }
+        }
+        findings.writeSection("df_uaf", error_findings);
+
+        llvm::outs() << "\n\n###########\n\nResults with DF/UAF Errors that have also been RAW_WRAPPED or RAW_REFERENCED:\n\n";
+        std::vector<value_states_t> raw_error_findings;
+        for (const auto &[llvm_value, states] : run_2.states())
+        {
+            if (is_informative(states) && states.containsAny(error_states) && states.containsAny(raw_states))
+            {
+                llvm::outs() << *llvm_value << " ==> " << states << "\n";
+                raw_error_findings.emplace_back(llvm_value, states);
+            }
+        }
+        findings.writeSection("df_uaf_raw", raw_error_findings);
+
+        // check with values from first run aswell by joining the two runs on the value
+
+        std::vector<value_states_t> run_1_filtered;
+        for (const auto &value_states : run_1.states())
+        {
+            if (is_informative(value_states.second))
+            {
+                run_1_filtered.push_back(value_states);
+            }
+        }
+        std::vector<value_states_t> run_2_filtered;
+        for (const auto &value_states : run_2.states())
+        {
+            if (is_informative(value_states.second))
+            {
+                run_2_filtered.push_back(value_states);
+            }
+        }
+        const auto merged_result = merge_states(run_1_filtered, run_2_filtered);
+
+        llvm::outs() << "\n\n###########\n\n===Merged=== Results with DF/UAF Errors that have also been RAW_WRAPPED or RAW_REFERENCED:\n\n";
+        std::vector<value_states_t> merged_findings;
+        for (const auto &[llvm_value, states] : merged_result)
+        {
+            if (states.containsAny(error_states) && states.containsAny(raw_states))
+            {
+                llvm::outs() << *llvm_value << " ==> " << states << "\n";
+                merged_findings.emplace_back(llvm_value, states);
+            }
+        }
+        findings.writeSection("merged_df_uaf_raw", merged_findings);
+
+        llvm::outs() << "\n\n###########\n\nCombined results:\n\n";
+        combine_results(HA, run_1, run_2, findings);
+
+        if (findings.enabled())
+        {
+            Instrumentation::global().setCounter("findings", findings.numFindings());
+            llvm::outs() << "\n" << findings.numFindings() << " findings written to " << Opts.findings_file << "\n";
+        }
+        llvm::outs() << "Done.\n\n";
+        return 0;
+    }
+
+} // namespace psr
@@ -0,0 +1,58 @@
+#ifndef TYPE_STATE_RUN_H
+#define TYPE_STATE_RUN_H
+
+#include "phasar.h"
+#include "UnsafeFunctions.h"
+
+#include <string>
+#include <vector>
+
+namespace psr
+{
+
+    enum class Engine
+    {
+        IDE,
+        BITVECTOR,
+        BOTH,
+        // answer backward queries at the call sites that can change a state only
+        DEMAND,
+        // run all engines and compare the others with the IDE results
+        ALL,
+    };
+
+    /**
+     * Options of the two unsafe drop typestate runs and their report,
+     * see the usage of unsafe-drop-ts for what each of them does.
+     */
+    struct TypeStateOptions
+    {
+        bool debug_log = false;
+        bool parallel_runs = false;
+        bool full_dump = false;
+        bool slice_unsafe = false;
+        // also solve the monomorphized functions of core, alloc and std
+        bool analyze_std = false;
+        Engine engine = Engine::IDE;
+        // empty to not write findings, stdout is taken by the report
+        std::string findings_file;
+        std::string cache_dir;
+        // empty to solve all functions
+        std::string incremental_state;
+    };
+
+    /**
+     * Solve both typestate runs over HA from EntryPoints and print the DF/UAF
+     * report to llvm::outs(), writing the findings if requested.
+     *
+     * With slice_unsafe, Unsafe is used to slice the solved functions if it is
+     * given, so a caller that already classified the unsafe code does not pay
+     * for it twice. Otherwise find_unsafe_code is run here.
+     * Returns the exit code of the tool.
+     */
+    int run_typestate(HelperAnalyses &HA, const std::vector<std::string> &EntryPoints,
+                      const TypeStateOptions &Opts, const UnsafeCode *Unsafe = nullptr);
+
+} // namespace psr
+
+#endif // TYPE_STATE_RUN_H
@@ -1,34 +1,15 @@
 #include <string>
 #include "UnsafeDropStateDescription.h"
+#include "UnsafeDropTransitions.h"
+#include "StdSummaries.h"
 #include "phasar/PhasarLLVM/DB/LLVMProjectIRDB.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "phasar.h"
-#include "rustc_demangle.h"
-
-#define RUSTC_DEMANGLE_STRING_OUT_LEN 1024
 
 namespace psr
 {
 
-    // NOTE: demangle is usually not needed as phasar already uses the
-    // function name annotated in the debug information of the ll file
-    std::string rustc_demangle_string(llvm::StringRef sr)
-    {
-        const std::string s = sr.str();
-        const char *mangled = s.c_str();
-        char out[RUSTC_DEMANGLE_STRING_OUT_LEN] = {0};
-        const int no_err = rustc_demangle(mangled, out, RUSTC_DEMANGLE_STRING_OUT_LEN);
-        if (!no_err)
-        {
-            PHASAR_LOG_LEVEL(DEBUG, "Could not demangle string with rustc_demangle, falling back to identity str=" << sr);
-            return sr.str();
-        }
-        auto out_string = std::string(out);
-        PHASAR_LOG_LEVEL(DEBUG, "demangled '" << sr << "' to '" << out_string << "'");
-        return out_string;
-    }
-
     template class IDETypeStateAnalysis<UnsafeDropStateDescription>;
 
     llvm::StringRef to_string(UnsafeDropToken Token) noexcept
@@ -78,179 +59,68 @@ namespace psr
         llvm::report_fatal_error("received unknown state!");
     }
 
-    UnsafeDropState Delta(UnsafeDropToken token, UnsafeDropState state, bool unsafe_construct_as_factory)
+    llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, UnsafeDropStateSet States)
     {
-        switch (token)
-        {
-        case UnsafeDropToken::STAR:
-            // identity
-            return state;
-        case UnsafeDropToken::GET_PTR:
-            switch (state)
-            {
-            case UnsafeDropState::BOT:
-                return UnsafeDropState::BOT;
-            case UnsafeDropState::UNINIT:
-                return UnsafeDropState::RAW_REFERENCED;
-            case UnsafeDropState::RAW_REFERENCED:
-                return UnsafeDropState::RAW_REFERENCED;
-            case UnsafeDropState::RAW_WRAPPED:
-                return UnsafeDropState::RAW_WRAPPED;
-            case UnsafeDropState::DROPPED:
-                return UnsafeDropState::UAF_ERROR;
-            case UnsafeDropState::USED:
-                return UnsafeDropState::USED;
-            case UnsafeDropState::UAF_ERROR:
-                return UnsafeDropState::UAF_ERROR;
-            case UnsafeDropState::DF_ERROR:
-                return UnsafeDropState::DF_ERROR;
-            case UnsafeDropState::TS_ERROR:
-                return UnsafeDropState::TS_ERROR;
-            case UnsafeDropState::TOP:
-                return UnsafeDropState::TOP;
-            }
-            llvm::report_fatal_error("received unknown state!");
-            break;
-        case UnsafeDropToken::UNSAFE_CONSTRUCT:
-            switch (state)
-            {
-            case UnsafeDropState::BOT:
-                return UnsafeDropState::BOT;
-            case UnsafeDropState::UNINIT:
-
-                /*
+        OS << "[ ";
+        States.forEach([&](UnsafeDropState S)
+                       { OS << to_string(S) << ", "; });
+        OS << "]";
+        return OS;
+    }
 
-                    as a second analysis ot overcome the limitation that not all functions are called in the same object
-                    but some are called on the original and some are called on the wrapped object
-                    - adapt this transition to be RAW_WRAPPED
-                    - allow UNSAFE_CONSTRUCT functions to be factory functions
-                    then run both the original analysis and the second and check if statement
-                        that calls a UNSAFE_CONSTRUCT function has a dataflow fact that is RAW_REFERENCED and uses it as an argument
-                */
+    typedef UnsafeDropStateDescription::FnInfo FnInfo;
 
-                if (unsafe_construct_as_factory)
-                {
-                    return UnsafeDropState::RAW_WRAPPED;
-                }
-                else
-                {
-                    return UnsafeDropState::TS_ERROR;
-                }
-            case UnsafeDropState::RAW_REFERENCED:
-                return UnsafeDropState::RAW_WRAPPED;
-            case UnsafeDropState::RAW_WRAPPED:
-                return UnsafeDropState::RAW_WRAPPED;
-            case UnsafeDropState::DROPPED:
-                return UnsafeDropState::UAF_ERROR;
-            case UnsafeDropState::USED:
-                return UnsafeDropState::USED;
-            case UnsafeDropState::UAF_ERROR:
-                return UnsafeDropState::UAF_ERROR;
-            case UnsafeDropState::DF_ERROR:
-                return UnsafeDropState::DF_ERROR;
-            case UnsafeDropState::TS_ERROR:
-                return UnsafeDropState::TS_ERROR;
-            case UnsafeDropState::TOP:
-                return UnsafeDropState::TOP;
-            }
-            llvm::report_fatal_error("received unknown state!");
-            break;
-        case UnsafeDropToken::DROP:
-            switch (state)
-            {
-            case UnsafeDropState::BOT:
-                return UnsafeDropState::BOT;
-            case UnsafeDropState::UNINIT:
-                //return UnsafeDropState::DROPPED;
-                return UnsafeDropState::TS_ERROR;
-            case UnsafeDropState::RAW_REFERENCED:
-                return UnsafeDropState::DROPPED;
-            case UnsafeDropState::RAW_WRAPPED:
-                return UnsafeDropState::DROPPED;
-            case UnsafeDropState::DROPPED:
-                return UnsafeDropState::DF_ERROR;
-            case UnsafeDropState::USED:
-                return UnsafeDropState::DROPPED;
-            case UnsafeDropState::UAF_ERROR:
-                return UnsafeDropState::UAF_ERROR;
-            case UnsafeDropState::DF_ERROR:
-                return UnsafeDropState::DF_ERROR;
-            case UnsafeDropState::TS_ERROR:
-                return UnsafeDropState::TS_ERROR;
-            case UnsafeDropState::TOP:
-                return UnsafeDropState::TOP;
-            }
-            llvm::report_fatal_error("received unknown state!");
-            break;
-        case UnsafeDropToken::USE:
-            switch (state)
-            {
-            case UnsafeDropState::BOT:
-                return UnsafeDropState::BOT;
-            case UnsafeDropState::UNINIT:
-                //return UnsafeDropState::USED;
-                return UnsafeDropState::TS_ERROR;
-            case UnsafeDropState::RAW_REFERENCED:
-                return UnsafeDropState::USED;
-            case UnsafeDropState::RAW_WRAPPED:
-                return UnsafeDropState::USED;
-            case UnsafeDropState::DROPPED:
-                return UnsafeDropState::UAF_ERROR;
-            case UnsafeDropState::USED:
-                return UnsafeDropState::USED;
-            case UnsafeDropState::UAF_ERROR:
-                return UnsafeDropState::UAF_ERROR;
-            case UnsafeDropState::DF_ERROR:
-                return UnsafeDropState::DF_ERROR;
-            case UnsafeDropState::TS_ERROR:
-                return UnsafeDropState::TS_ERROR;
-            case UnsafeDropState::TOP:
-                return UnsafeDropState::TOP;
-            }
-            llvm::report_fatal_error("received unknown state!");
-            break;
+    const FnInfo &UnsafeDropStateDescription::getFnInfo(llvm::StringRef F) const
+    {
+        auto it = this->fn_info_cache.find(F);
+        if (it != this->fn_info_cache.end())
+        {
+            ++this->fn_info_cache_hits;
+            return it->second;
         }
-        llvm::report_fatal_error("received unknown token!");
+        ++this->fn_info_cache_misses;
+        auto Info = this->classifyFn(F);
+        if (Info.is_factory_fn)
+        {
+            this->addSretFactoryParams(F, Info);
+        }
+        // NOTE: StringMap entries are not moved on rehash, the reference stays valid
+        return this->fn_info_cache.try_emplace(F, std::move(Info)).first->second;
     }
 
-    typedef UnsafeDropStateDescription::FnInfo FnInfo;
+    void UnsafeDropStateDescription::printCacheStats(llvm::raw_ostream &OS) const
+    {
+        OS << "FnInfo cache: " << this->fn_info_cache.size() << " functions, "
+           << this->fn_info_cache_hits << " hits, "
+           << this->fn_info_cache_misses << " misses\n";
+    }
 
-    const llvm::StringMap<FnInfo> &getInterestingFns() noexcept
+    bool UnsafeDropStateDescription::isSummarized(const llvm::Function &F) const
     {
-        // TODO: add more interesting functions that match the substring checks of funcNameToToken
-        // Return value is modeled as -1
-        static const llvm::StringMap<FnInfo> InterestingFns = {
-            {"<alloc::boxed::Box<u32>>::from_raw", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::UNSAFE_CONSTRUCT}},
-            {"<alloc::boxed::Box<u32>>::into_raw", FnInfo{.is_factory_fn = true, .factory_param_idxs = {-1}, .consumer_param_idxs = {}, .token = UnsafeDropToken::GET_PTR }},
-            {"<alloc::raw_vec::RawVec<i32> as core::ops::drop::Drop>::drop", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"<alloc::raw_vec::RawVec<u8> as core::ops::drop::Drop>::drop", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"<alloc::vec::Vec<f32>>::as_mut_ptr", FnInfo{.is_factory_fn = true, .factory_param_idxs = {-1}, .consumer_param_idxs = {}, .token = UnsafeDropToken::GET_PTR}},
-            {"<alloc::vec::Vec<f32>>::from_raw_parts", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0, 1}, .token = UnsafeDropToken::UNSAFE_CONSTRUCT}},
-            {"<alloc::vec::Vec<i32>>::as_mut_ptr", FnInfo{.is_factory_fn = true, .factory_param_idxs = {-1}, .consumer_param_idxs = {}, .token = UnsafeDropToken::GET_PTR}},
-            {"<alloc::vec::Vec<u8>>::as_mut_ptr", FnInfo{.is_factory_fn = true, .factory_param_idxs = {-1}, .consumer_param_idxs = {}, .token = UnsafeDropToken::GET_PTR}},
-            {"<alloc::vec::Vec<u8>>::from_raw_parts", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0, 1}, .token = UnsafeDropToken::UNSAFE_CONSTRUCT}},
-            {"<str>::as_mut_ptr", FnInfo{.is_factory_fn = true, .factory_param_idxs = {-1}, .consumer_param_idxs = {}, .token = UnsafeDropToken::GET_PTR}},
-            {"core::mem::drop::<alloc::boxed::Box<u32>>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"core::ptr::drop_in_place::<alloc::boxed::Box<u32>>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"core::ptr::drop_in_place::<alloc::raw_vec::RawVec<f32>>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"core::ptr::drop_in_place::<alloc::raw_vec::RawVec<u8>>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"core::ptr::drop_in_place::<alloc::string::String>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"core::ptr::drop_in_place::<alloc::vec::Vec<u8>>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::DROP}},
-            {"core::slice::raw::from_raw_parts_mut::<u8>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::UNSAFE_CONSTRUCT}},
-            {"core::slice::raw::from_raw_parts::<f32>", FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = {0}, .token = UnsafeDropToken::UNSAFE_CONSTRUCT}},
-        };
-        return InterestingFns;
+        return this->summarize_std && !F.isDeclaration() && is_std_function(DemangleCache::global().demangle(&F));
     }
 
-    FnInfo UnsafeDropStateDescription::getFnInfo(llvm::StringRef F) const
+    FnInfo UnsafeDropStateDescription::classifyFn(llvm::StringRef F) const
     {
         // overwrite the is_facory_fn and factory_param_idxs if token == UnsafeDropToken::UNSAFE_CONSTRUCT}
 
-        // first check if there is a concrete function that matches the function name
-        auto fns = getInterestingFns();
-        if (fns.count(F))
+        // first check if there is a summary of the std function, whatever its generic arguments are
+        // Return value is modeled as -1
+        if (const auto *summary = lookup_std_summary(F))
         {
-            FnInfo Ret = fns.lookup(F);
+            FnInfo Ret;
+            switch (summary->Kind)
+            {
+            case StdFnKind::RAW_PTR_OUT:
+                Ret = FnInfo{.is_factory_fn = true, .factory_param_idxs = {-1}, .consumer_param_idxs = {}, .token = UnsafeDropToken::GET_PTR};
+                break;
+            case StdFnKind::RAW_PTR_IN:
+                Ret = FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = summary->ConsumedParams, .token = UnsafeDropToken::UNSAFE_CONSTRUCT};
+                break;
+            case StdFnKind::DROP:
+                Ret = FnInfo{.is_factory_fn = false, .factory_param_idxs = {}, .consumer_param_idxs = summary->ConsumedParams, .token = UnsafeDropToken::DROP};
+                break;
+            }
             if (Ret.token == UnsafeDropToken::UNSAFE_CONSTRUCT && this->unsafe_construct_as_factory)
             {
                 Ret.is_factory_fn = true;
@@ -319,15 +189,14 @@ namespace psr
     {
         PHASAR_LOG_LEVEL(DEBUG, "isFactoryFunction: " << F);
 
-        auto fnInfo = this->getFnInfo(F);
+        const auto &fnInfo = this->getFnInfo(F);
         return fnInfo.is_factory_fn || fnInfo.token == UnsafeDropToken::GET_PTR;
     }
 
     bool UnsafeDropStateDescription::isConsumingFunction(llvm::StringRef F) const
     {
         PHASAR_LOG_LEVEL(DEBUG, "isConsumingFunction: " << F);
-        auto fnInfo = this->getFnInfo(F);
-        return !fnInfo.is_factory_fn;
+        return !this->getFnInfo(F).is_factory_fn;
     }
 
     bool UnsafeDropStateDescription::isAPIFunction(llvm::StringRef F) const
@@ -341,7 +210,7 @@ namespace psr
                                              UnsafeDropState S) const
     {
         auto token = this->funcNameToToken(Tok);
-        auto next = Delta(token, S, this->unsafe_construct_as_factory);
+        auto next = next_state(token, S, this->unsafe_construct_as_factory);
         PHASAR_LOG_LEVEL(DEBUG, "getNextState: fun=" << Tok << " token=" << to_string(token) << " state=" << to_string(S) << " next=" << to_string(next));
         return next;
     }
@@ -356,40 +225,37 @@ namespace psr
     UnsafeDropStateDescription::getConsumerParamIdx(llvm::StringRef F) const
     {
         PHASAR_LOG_LEVEL(DEBUG, "getConsumerParamIdx: " << F);
-        auto fnInfo = this->getFnInfo(F);
-        return fnInfo.consumer_param_idxs;
+        return this->getFnInfo(F).consumer_param_idxs;
     }
 
     std::set<int>
     UnsafeDropStateDescription::getFactoryParamIdx(llvm::StringRef F) const
     {
         PHASAR_LOG_LEVEL(DEBUG, "getFactoryParamIdx: " << F);
-        auto fnInfo = this->getFnInfo(F);
-        if (fnInfo.is_factory_fn)
+        // NOTE: sret params of factory functions are already added when F is classified
+        return this->getFnInfo(F).factory_param_idxs;
+    }
+
+    void UnsafeDropStateDescription::addSretFactoryParams(llvm::StringRef F, FnInfo &Info) const
+    {
+        const auto *fn = DemangleCache::global().lookup(F);
+        if (!fn)
         {
-            auto fn_opt = this->demangled_lookup.lookup(F);
-            if (!fn_opt.has_value())
-            {
-                PHASAR_LOG_LEVEL(DEBUG, "Warning: getFactoryParamIdx: DemangledLookup::lookup failed for F=" << F);
-            }
-            // try to handle sret if we can get the information
-            if (fn_opt.has_value())
+            PHASAR_LOG_LEVEL(DEBUG, "Warning: getFactoryParamIdx: DemangleCache::lookup failed for F=" << F);
+            return;
+        }
+        // try to handle sret if we can get the information
+        int arg_num = 0;
+        for (auto &arg : fn->args())
+        {
+            // check if sret is used
+            if (arg.hasStructRetAttr())
             {
-                auto fn = fn_opt.value();
-                int arg_num = 0;
-                for (auto &arg : fn->args())
-                {
-                    // check if sret is used
-                    if (arg.hasStructRetAttr())
-                    {
-                        PHASAR_LOG_LEVEL(DEBUG, "getFactoryParamIdx: Setting sret arg as factory param F=" << F << " arg_num=" << arg_num);
-                        fnInfo.factory_param_idxs.emplace(arg_num);
-                    }
-                    arg_num++;
-                }
+                PHASAR_LOG_LEVEL(DEBUG, "getFactoryParamIdx: Setting sret arg as factory param F=" << F << " arg_num=" << arg_num);
+                Info.factory_param_idxs.emplace(arg_num);
             }
+            arg_num++;
         }
-        return fnInfo.factory_param_idxs;
     }
 
 } // namespace psr
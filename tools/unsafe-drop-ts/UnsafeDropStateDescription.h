@@ -1,56 +1,20 @@
 #ifndef UNSAFE_DROP_STATE_DESCRIPTION_H
 #define UNSAFE_DROP_STATE_DESCRIPTION_H
 
+#include <initializer_list>
 #include <map>
 #include <set>
 #include <string>
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "phasar.h"
+#include "DemangleCache.h"
 #include "phasar/PhasarLLVM/DataFlow/IfdsIde/Problems/IDETypeStateAnalysis.h"
 #include "phasar/PhasarLLVM/DataFlow/IfdsIde/Problems/TypeStateDescriptions/TypeStateDescription.h"
 
 namespace psr
 {
 
-    /**
-     * Reverse lookup map of mangled names to function definitions.
-     * Computed for all functions in the LLVM IR.
-     */
-    class DemangledLookup
-    {
-    private:
-        HelperAnalyses &HA;
-        llvm::StringMap<const llvm::Function *> Map;
-
-    public:
-        /**
-         * Constructor to build the reverse lookup table from the HelperAnalysis
-         */
-        DemangledLookup(HelperAnalyses &HA)
-            : HA(HA),
-              Map(llvm::StringMap<const llvm::Function *>())
-        {
-            for (const auto F : HA.getProjectIRDB().getAllFunctions())
-            {
-                const auto demangled = llvm::demangle(F->getName().str());
-                this->Map.insert(std::make_pair(llvm::StringRef(demangled), F));
-            }
-        }
-
-        /**
-         * Try to lookup a demangled function name.
-         * If found returns the function definition.
-         */
-        std::optional<const llvm::Function *> lookup(llvm::StringRef Demangled) const
-        {
-            if (this->Map.count(Demangled))
-            {
-                return this->Map.lookup(Demangled);
-            }
-            return std::nullopt;
-        }
-    }; // class DemangledLookup
-
     // template parameter to specialize which lattice implementation is used
     enum class UnsafeDropStateLatticeKind
     {
@@ -98,6 +62,120 @@ namespace psr
 
     llvm::StringRef to_string(UnsafeDropState State) noexcept;
 
+    // number of distinct UnsafeDropState values, including TOP and BOT
+    constexpr unsigned NumUnsafeDropStates = 10;
+
+    /**
+     * Dense index of a state in [0, NumUnsafeDropStates),
+     * following the order of the enum values, i.e. TOP is 0 and BOT is 9.
+     */
+    constexpr unsigned state_index(UnsafeDropState State) noexcept
+    {
+        switch (State)
+        {
+        case UnsafeDropState::TOP:
+            return 0;
+        case UnsafeDropState::BOT:
+            return NumUnsafeDropStates - 1;
+        default:
+            return static_cast<unsigned>(static_cast<int8_t>(State)) + 1;
+        }
+    }
+
+    constexpr UnsafeDropState state_from_index(unsigned Idx) noexcept
+    {
+        if (Idx == 0)
+        {
+            return UnsafeDropState::TOP;
+        }
+        if (Idx >= NumUnsafeDropStates - 1)
+        {
+            return UnsafeDropState::BOT;
+        }
+        return static_cast<UnsafeDropState>(static_cast<int8_t>(Idx - 1));
+    }
+
+    /**
+     * A set of states, stored as a bitmask indexed by state_index.
+     * All states a value can be in fit in 16 bits.
+     */
+    class UnsafeDropStateSet
+    {
+    private:
+        uint16_t Mask = 0;
+
+        constexpr explicit UnsafeDropStateSet(uint16_t Mask) noexcept : Mask(Mask) {}
+
+    public:
+        constexpr UnsafeDropStateSet() noexcept = default;
+        constexpr UnsafeDropStateSet(std::initializer_list<UnsafeDropState> States) noexcept
+        {
+            for (auto S : States)
+            {
+                insert(S);
+            }
+        }
+
+        static constexpr UnsafeDropStateSet fromMask(uint16_t Mask) noexcept
+        {
+            return UnsafeDropStateSet(Mask);
+        }
+
+        [[nodiscard]] constexpr uint16_t mask() const noexcept { return Mask; }
+        [[nodiscard]] constexpr bool empty() const noexcept { return Mask == 0; }
+
+        constexpr void insert(UnsafeDropState S) noexcept
+        {
+            Mask |= uint16_t(1U << state_index(S));
+        }
+        [[nodiscard]] constexpr bool contains(UnsafeDropState S) const noexcept
+        {
+            return Mask & (1U << state_index(S));
+        }
+        [[nodiscard]] constexpr bool containsAny(UnsafeDropStateSet Other) const noexcept
+        {
+            return Mask & Other.Mask;
+        }
+        // true if this set contains a state that is not in Other
+        [[nodiscard]] constexpr bool containsOtherThan(UnsafeDropStateSet Other) const noexcept
+        {
+            return Mask & ~Other.Mask;
+        }
+
+        constexpr UnsafeDropStateSet &operator|=(UnsafeDropStateSet Other) noexcept
+        {
+            Mask |= Other.Mask;
+            return *this;
+        }
+        friend constexpr UnsafeDropStateSet operator|(UnsafeDropStateSet L, UnsafeDropStateSet R) noexcept
+        {
+            return UnsafeDropStateSet(L.Mask | R.Mask);
+        }
+        friend constexpr bool operator==(UnsafeDropStateSet L, UnsafeDropStateSet R) noexcept
+        {
+            return L.Mask == R.Mask;
+        }
+        friend constexpr bool operator!=(UnsafeDropStateSet L, UnsafeDropStateSet R) noexcept
+        {
+            return L.Mask != R.Mask;
+        }
+
+        // call Fn for each contained state, in the order of the enum values
+        template <typename FnT>
+        void forEach(FnT Fn) const
+        {
+            for (unsigned Idx = 0; Idx < NumUnsafeDropStates; ++Idx)
+            {
+                if (Mask & (1U << Idx))
+                {
+                    Fn(state_from_index(Idx));
+                }
+            }
+        }
+    }; // class UnsafeDropStateSet
+
+    llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, UnsafeDropStateSet States);
+
     /**
      * The transition tokens of the Finite State machine, i.e. the functions called.
      * The STAR token represents all API that are not relevant.
@@ -170,20 +248,38 @@ namespace psr
     private:
         HelperAnalyses &HA;
         bool unsafe_construct_as_factory;
-        DemangledLookup demangled_lookup;
-        UnsafeDropStateDescription::FnInfo getFnInfo(llvm::StringRef F) const;
+        // calls into core, alloc and std are only classified, their monomorphized bodies are not entered
+        bool summarize_std;
+
+        // classification of each demangled function name, filled on first use,
+        // as the solver queries the same few call targets over and over again
+        mutable llvm::StringMap<FnInfo> fn_info_cache;
+        mutable size_t fn_info_cache_hits = 0;
+        mutable size_t fn_info_cache_misses = 0;
+
+        FnInfo classifyFn(llvm::StringRef F) const;
+        void addSretFactoryParams(llvm::StringRef F, FnInfo &Info) const;
+        const FnInfo &getFnInfo(llvm::StringRef F) const;
+
     public:
         UnsafeDropToken funcNameToToken(llvm::StringRef F) const;
 
+        void printCacheStats(llvm::raw_ostream &OS) const;
+
+        // true if F is a definition of core, alloc or std that the analyses must not enter at its calls
+        [[nodiscard]] bool isSummarized(const llvm::Function &F) const;
+
     public:
         UnsafeDropStateDescription(HelperAnalyses &HA)
             : UnsafeDropStateDescription(HA, false) {}
 
-        UnsafeDropStateDescription(HelperAnalyses &HA, bool unsafe_construct_as_factory)
+        UnsafeDropStateDescription(HelperAnalyses &HA, bool unsafe_construct_as_factory, bool summarize_std = false)
             : HA(HA),
               unsafe_construct_as_factory(unsafe_construct_as_factory),
-              demangled_lookup(DemangledLookup(HA))
+              summarize_std(summarize_std)
         {
+            // the names passed in by PhASAR are demangled, so all functions must be found by their demangled name
+            DemangleCache::global().addModule(*HA.getProjectIRDB().getModule());
         }
 
         using TypeStateDescription::getNextState;
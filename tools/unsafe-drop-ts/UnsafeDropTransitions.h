@@ -0,0 +1,204 @@
+#ifndef UNSAFE_DROP_TRANSITIONS_H
+#define UNSAFE_DROP_TRANSITIONS_H
+
+#include "UnsafeDropStateDescription.h"
+
+#include <array>
+#include <cstddef>
+
+namespace psr
+{
+
+    // number of distinct UnsafeDropToken values
+    constexpr unsigned NumUnsafeDropTokens = 5;
+
+    constexpr unsigned token_index(UnsafeDropToken Token) noexcept
+    {
+        return static_cast<unsigned>(Token);
+    }
+
+    // next state of every state, indexed by state_index
+    using transition_row_t = std::array<UnsafeDropState, NumUnsafeDropStates>;
+    // the transition function of the FSM, one row per token, indexed by token_index
+    using transition_table_t = std::array<transition_row_t, NumUnsafeDropTokens>;
+
+    namespace detail
+    {
+
+        // not a valid UnsafeDropState, marks the transitions a row is missing
+        constexpr auto NoTransition = static_cast<UnsafeDropState>(-1);
+
+        struct Transition
+        {
+            UnsafeDropState From;
+            UnsafeDropState To;
+        };
+
+        // a row must list every state exactly once, which is_total checks
+        template <size_t N>
+        constexpr transition_row_t make_row(const Transition (&Transitions)[N]) noexcept
+        {
+            static_assert(N == NumUnsafeDropStates, "a row needs one transition per state");
+            transition_row_t Row{};
+            for (auto &To : Row)
+            {
+                To = NoTransition;
+            }
+            for (const auto &T : Transitions)
+            {
+                Row[state_index(T.From)] = T.To;
+            }
+            return Row;
+        }
+
+        constexpr transition_table_t make_transition_table(bool UnsafeConstructAsFactory) noexcept
+        {
+            using S = UnsafeDropState;
+            using T = UnsafeDropToken;
+            transition_table_t Table{};
+
+            for (unsigned Idx = 0; Idx < NumUnsafeDropStates; ++Idx)
+            {
+                Table[token_index(T::STAR)][Idx] = state_from_index(Idx);
+            }
+
+            Table[token_index(T::GET_PTR)] = make_row({
+                {S::TOP, S::TOP},
+                {S::TS_ERROR, S::TS_ERROR},
+                {S::UNINIT, S::RAW_REFERENCED},
+                {S::RAW_REFERENCED, S::RAW_REFERENCED},
+                {S::RAW_WRAPPED, S::RAW_WRAPPED},
+                {S::USED, S::USED},
+                {S::DROPPED, S::UAF_ERROR},
+                {S::UAF_ERROR, S::UAF_ERROR},
+                {S::DF_ERROR, S::DF_ERROR},
+                {S::BOT, S::BOT},
+            });
+
+            /*
+                as a second analysis ot overcome the limitation that not all functions are called in the same object
+                but some are called on the original and some are called on the wrapped object
+                - adapt the transition of UNINIT to be RAW_WRAPPED
+                - allow UNSAFE_CONSTRUCT functions to be factory functions
+                then run both the original analysis and the second and check if statement
+                    that calls a UNSAFE_CONSTRUCT function has a dataflow fact that is RAW_REFERENCED and uses it as an argument
+            */
+            Table[token_index(T::UNSAFE_CONSTRUCT)] = make_row({
+                {S::TOP, S::TOP},
+                {S::TS_ERROR, S::TS_ERROR},
+                {S::UNINIT, UnsafeConstructAsFactory ? S::RAW_WRAPPED : S::TS_ERROR},
+                {S::RAW_REFERENCED, S::RAW_WRAPPED},
+                {S::RAW_WRAPPED, S::RAW_WRAPPED},
+                {S::USED, S::USED},
+                {S::DROPPED, S::UAF_ERROR},
+                {S::UAF_ERROR, S::UAF_ERROR},
+                {S::DF_ERROR, S::DF_ERROR},
+                {S::BOT, S::BOT},
+            });
+
+            Table[token_index(T::DROP)] = make_row({
+                {S::TOP, S::TOP},
+                {S::TS_ERROR, S::TS_ERROR},
+                // {S::UNINIT, S::DROPPED},
+                {S::UNINIT, S::TS_ERROR},
+                {S::RAW_REFERENCED, S::DROPPED},
+                {S::RAW_WRAPPED, S::DROPPED},
+                {S::USED, S::DROPPED},
+                {S::DROPPED, S::DF_ERROR},
+                // a freed value was dropped again, DROPPED -> DF_ERROR requires this to be at least DF_ERROR
+                {S::UAF_ERROR, S::DF_ERROR},
+                {S::DF_ERROR, S::DF_ERROR},
+                {S::BOT, S::BOT},
+            });
+
+            Table[token_index(T::USE)] = make_row({
+                {S::TOP, S::TOP},
+                {S::TS_ERROR, S::TS_ERROR},
+                // {S::UNINIT, S::USED},
+                {S::UNINIT, S::TS_ERROR},
+                {S::RAW_REFERENCED, S::USED},
+                {S::RAW_WRAPPED, S::USED},
+                {S::USED, S::USED},
+                {S::DROPPED, S::UAF_ERROR},
+                {S::UAF_ERROR, S::UAF_ERROR},
+                {S::DF_ERROR, S::DF_ERROR},
+                {S::BOT, S::BOT},
+            });
+
+            return Table;
+        }
+
+        constexpr bool is_total(const transition_table_t &Table) noexcept
+        {
+            for (const auto &Row : Table)
+            {
+                for (const auto To : Row)
+                {
+                    if (To == NoTransition)
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // A <= B implies delta(A) <= delta(B) for every token, in the order given by join
+        constexpr bool is_monotone(const transition_table_t &Table) noexcept
+        {
+            using L = JoinLatticeTraits<UnsafeDropState>;
+            for (const auto &Row : Table)
+            {
+                for (unsigned A = 0; A < NumUnsafeDropStates; ++A)
+                {
+                    for (unsigned B = 0; B < NumUnsafeDropStates; ++B)
+                    {
+                        const bool below = L::join(state_from_index(A), state_from_index(B)) == state_from_index(B);
+                        if (below && L::join(Row[A], Row[B]) != Row[B])
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+    } // namespace detail
+
+    /**
+     * The transition function of the FSM as tables, indexed by
+     * [unsafe_construct_as_factory][token_index][state_index].
+     */
+    constexpr std::array<transition_table_t, 2> UnsafeDropTransitions = {
+        detail::make_transition_table(false),
+        detail::make_transition_table(true),
+    };
+
+    static_assert(detail::is_total(UnsafeDropTransitions[0]) && detail::is_total(UnsafeDropTransitions[1]),
+                  "every token needs a transition for every state");
+    static_assert(detail::is_monotone(UnsafeDropTransitions[0]) && detail::is_monotone(UnsafeDropTransitions[1]),
+                  "transitions must be monotone in the lattice of UnsafeDropState");
+
+    constexpr UnsafeDropState next_state(UnsafeDropToken Token, UnsafeDropState State, bool UnsafeConstructAsFactory) noexcept
+    {
+        return UnsafeDropTransitions[UnsafeConstructAsFactory][token_index(Token)][state_index(State)];
+    }
+
+    // the join of all states in States, TOP for the empty set
+    constexpr UnsafeDropState join_of(UnsafeDropStateSet States) noexcept
+    {
+        auto Joined = JoinLatticeTraits<UnsafeDropState>::top();
+        for (unsigned Idx = 0; Idx < NumUnsafeDropStates; ++Idx)
+        {
+            if (States.contains(state_from_index(Idx)))
+            {
+                Joined = JoinLatticeTraits<UnsafeDropState>::join(Joined, state_from_index(Idx));
+            }
+        }
+        return Joined;
+    }
+
+} // namespace psr
+
+#endif // UNSAFE_DROP_TRANSITIONS_H
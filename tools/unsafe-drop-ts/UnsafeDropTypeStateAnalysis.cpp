@@ -0,0 +1,177 @@
+#include "UnsafeDropTypeStateAnalysis.h"
+
+#include "llvm/Support/Casting.h"
+
+#include <algorithm>
+
+namespace psr
+{
+
+    const UnsafeDropTransfer *UnsafeDropTransferTable::intern(const transition_row_t &Next)
+    {
+        uint64_t key = 0;
+        for (const auto S : Next)
+        {
+            key = (key << 4) | state_index(S);
+        }
+        auto [it, inserted] = ByKey.try_emplace(key, nullptr);
+        if (inserted)
+        {
+            const bool is_constant = std::all_of(Next.begin(), Next.end(), [&](UnsafeDropState S)
+                                                 { return S == Next.front(); });
+            it->second = &Transfers.emplace_back(
+                UnsafeDropTransfer{Next, static_cast<uint32_t>(Transfers.size()), is_constant, this});
+        }
+        return it->second;
+    }
+
+    const UnsafeDropTransfer *UnsafeDropTransferTable::compose(const UnsafeDropTransfer *First, const UnsafeDropTransfer *Second)
+    {
+        auto [it, inserted] = Composed.try_emplace(std::make_pair(First->Id, Second->Id), nullptr);
+        if (!inserted)
+        {
+            ++MemoHits;
+            return it->second;
+        }
+        ++MemoMisses;
+        transition_row_t Next{};
+        for (unsigned Idx = 0; Idx < NumUnsafeDropStates; ++Idx)
+        {
+            Next[Idx] = Second->Next[state_index(First->Next[Idx])];
+        }
+        // intern does not insert into Composed, so it is still valid
+        it->second = intern(Next);
+        return it->second;
+    }
+
+    const UnsafeDropTransfer *UnsafeDropTransferTable::join(const UnsafeDropTransfer *L, const UnsafeDropTransfer *R)
+    {
+        if (L == R)
+        {
+            return L;
+        }
+        // join is commutative, so both orders share one entry
+        auto [it, inserted] = Joined.try_emplace(std::minmax(L->Id, R->Id), nullptr);
+        if (!inserted)
+        {
+            ++MemoHits;
+            return it->second;
+        }
+        ++MemoMisses;
+        transition_row_t Next{};
+        for (unsigned Idx = 0; Idx < NumUnsafeDropStates; ++Idx)
+        {
+            Next[Idx] = JoinLatticeTraits<UnsafeDropState>::join(L->Next[Idx], R->Next[Idx]);
+        }
+        it->second = intern(Next);
+        return it->second;
+    }
+
+    void UnsafeDropTransferTable::printStats(llvm::raw_ostream &OS) const
+    {
+        OS << "Edge function table: " << Transfers.size() << " distinct edge functions, "
+           << MemoHits << " memoized compose/join hits, " << MemoMisses << " misses\n";
+    }
+
+    EdgeFunction<UnsafeDropState> UnsafeDropTransferEF::compose(EdgeFunctionRef<UnsafeDropTransferEF> This,
+                                                                const EdgeFunction<l_t> &SecondFunction)
+    {
+        // This is applied first, then SecondFunction
+        if (llvm::isa<EdgeIdentity<l_t>>(SecondFunction))
+        {
+            return This;
+        }
+        if (SecondFunction.isConstant())
+        {
+            return SecondFunction;
+        }
+        auto *Table = This->Transfer->Table;
+        if (const auto *Second = llvm::dyn_cast<UnsafeDropTransferEF>(SecondFunction))
+        {
+            return UnsafeDropTransferEF{Table->compose(This->Transfer, Second->Transfer)};
+        }
+        return UnsafeDropTransferEF{Table->tabulate([&](l_t S)
+                                                    { return SecondFunction.computeTarget(This->computeTarget(S)); })};
+    }
+
+    EdgeFunction<UnsafeDropState> UnsafeDropTransferEF::join(EdgeFunctionRef<UnsafeDropTransferEF> This,
+                                                             const EdgeFunction<l_t> &OtherFunction)
+    {
+        auto *Table = This->Transfer->Table;
+        if (const auto *Other = llvm::dyn_cast<UnsafeDropTransferEF>(OtherFunction))
+        {
+            return UnsafeDropTransferEF{Table->join(This->Transfer, Other->Transfer)};
+        }
+        if (llvm::isa<AllTop<l_t>>(OtherFunction))
+        {
+            return This;
+        }
+        if (llvm::isa<AllBottom<l_t>>(OtherFunction))
+        {
+            return OtherFunction;
+        }
+        return UnsafeDropTransferEF{Table->tabulate([&](l_t S)
+                                                    { return JoinLatticeTraits<l_t>::join(This->computeTarget(S), OtherFunction.computeTarget(S)); })};
+    }
+
+    llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, UnsafeDropTransferEF EF)
+    {
+        OS << "UnsafeDropTransferEF#" << EF.Transfer->Id << "[ ";
+        for (unsigned Idx = 0; Idx < NumUnsafeDropStates; ++Idx)
+        {
+            OS << to_string(state_from_index(Idx)) << " -> " << to_string(EF.Transfer->Next[Idx]) << ", ";
+        }
+        return OS << "]";
+    }
+
+    EdgeFunction<UnsafeDropTypeStateAnalysis::l_t> UnsafeDropTypeStateAnalysis::tabulated(EdgeFunction<l_t> EF) const
+    {
+        // identity, all-top and all-bottom are singletons the solver already handles without allocating
+        if (!EF || llvm::isa<EdgeIdentity<l_t>>(EF) || llvm::isa<AllTop<l_t>>(EF) ||
+            llvm::isa<AllBottom<l_t>>(EF) || llvm::isa<UnsafeDropTransferEF>(EF))
+        {
+            return EF;
+        }
+        return UnsafeDropTransferEF{Transfers->tabulate([&](l_t S)
+                                                        { return EF.computeTarget(S); })};
+    }
+
+    EdgeFunction<UnsafeDropTypeStateAnalysis::l_t>
+    UnsafeDropTypeStateAnalysis::getNormalEdgeFunction(n_t Curr, d_t CurrNode, n_t Succ, d_t SuccNode)
+    {
+        ++NumEdgeFunctionQueries;
+        return tabulated(base_t::getNormalEdgeFunction(Curr, CurrNode, Succ, SuccNode));
+    }
+
+    EdgeFunction<UnsafeDropTypeStateAnalysis::l_t>
+    UnsafeDropTypeStateAnalysis::getCallToRetEdgeFunction(n_t CallSite, d_t CallNode, n_t RetSite, d_t RetSiteNode,
+                                                          llvm::ArrayRef<f_t> Callees)
+    {
+        ++NumEdgeFunctionQueries;
+        return tabulated(base_t::getCallToRetEdgeFunction(CallSite, CallNode, RetSite, RetSiteNode, Callees));
+    }
+
+    UnsafeDropTypeStateAnalysis::FlowFunctionPtrType
+    UnsafeDropTypeStateAnalysis::getSummaryFlowFunction(n_t CallSite, f_t DestFun)
+    {
+        if (!Description->isSummarized(*DestFun))
+        {
+            return base_t::getSummaryFlowFunction(CallSite, DestFun);
+        }
+        ++NumSummarizedCalls;
+        return killAllFlows<d_t>();
+    }
+
+    EdgeFunction<UnsafeDropTypeStateAnalysis::l_t>
+    UnsafeDropTypeStateAnalysis::getSummaryEdgeFunction(n_t CallSite, d_t CallNode, n_t RetSite, d_t RetSiteNode)
+    {
+        ++NumEdgeFunctionQueries;
+        // only the zero fact passes the summary flow of a summarized callee
+        if (isZeroValue(CallNode))
+        {
+            return EdgeIdentity<l_t>{};
+        }
+        return tabulated(base_t::getSummaryEdgeFunction(CallSite, CallNode, RetSite, RetSiteNode));
+    }
+
+} // namespace psr
@@ -0,0 +1,164 @@
+#ifndef UNSAFE_DROP_TYPE_STATE_ANALYSIS_H
+#define UNSAFE_DROP_TYPE_STATE_ANALYSIS_H
+
+#include "UnsafeDropStateDescription.h"
+#include "UnsafeDropTransitions.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace psr
+{
+
+    class UnsafeDropTransferTable;
+
+    /**
+     * An edge function of the unsafe drop typestate problem, tabulated:
+     * Next[state_index(S)] is the value of the function for S.
+     * Interned, so two transfers are equal iff they are the same object.
+     */
+    struct UnsafeDropTransfer
+    {
+        transition_row_t Next;
+        uint32_t Id;
+        bool IsConstant;
+        UnsafeDropTransferTable *Table;
+    };
+
+    /**
+     * Hash-consed table of all transfers of one problem, with memoized
+     * composition and join. Not thread-safe, every problem has its own table.
+     */
+    class UnsafeDropTransferTable
+    {
+    private:
+        // deque, so the transfers never move
+        std::deque<UnsafeDropTransfer> Transfers;
+        // the state indices of a transfer packed into 4 bits each
+        llvm::DenseMap<uint64_t, const UnsafeDropTransfer *> ByKey;
+        llvm::DenseMap<std::pair<uint32_t, uint32_t>, const UnsafeDropTransfer *> Composed;
+        llvm::DenseMap<std::pair<uint32_t, uint32_t>, const UnsafeDropTransfer *> Joined;
+        size_t MemoHits = 0;
+        size_t MemoMisses = 0;
+
+    public:
+        const UnsafeDropTransfer *intern(const transition_row_t &Next);
+
+        // the transfer of Fn, which must be a map of states
+        template <typename FnT>
+        const UnsafeDropTransfer *tabulate(FnT Fn)
+        {
+            transition_row_t Next{};
+            for (unsigned Idx = 0; Idx < NumUnsafeDropStates; ++Idx)
+            {
+                Next[Idx] = Fn(state_from_index(Idx));
+            }
+            return intern(Next);
+        }
+
+        // First, then Second
+        const UnsafeDropTransfer *compose(const UnsafeDropTransfer *First, const UnsafeDropTransfer *Second);
+
+        // pointwise join of L and R
+        const UnsafeDropTransfer *join(const UnsafeDropTransfer *L, const UnsafeDropTransfer *R);
+
+        [[nodiscard]] size_t size() const { return Transfers.size(); }
+        [[nodiscard]] size_t memoHits() const { return MemoHits; }
+        [[nodiscard]] size_t memoMisses() const { return MemoMisses; }
+
+        void printStats(llvm::raw_ostream &OS) const;
+    }; // class UnsafeDropTransferTable
+
+    /**
+     * Edge function holding a single interned transfer, small enough to be
+     * stored inside EdgeFunction without allocating. Composition and join with
+     * another transfer are table lookups, any other non-trivial edge function
+     * it meets is tabulated into a transfer first.
+     */
+    struct UnsafeDropTransferEF
+    {
+        using l_t = UnsafeDropState;
+
+        const UnsafeDropTransfer *Transfer{};
+
+        [[nodiscard]] l_t computeTarget(l_t Source) const noexcept
+        {
+            return Transfer->Next[state_index(Source)];
+        }
+
+        [[nodiscard]] bool isConstant() const noexcept { return Transfer->IsConstant; }
+
+        static EdgeFunction<l_t> compose(EdgeFunctionRef<UnsafeDropTransferEF> This,
+                                         const EdgeFunction<l_t> &SecondFunction);
+
+        static EdgeFunction<l_t> join(EdgeFunctionRef<UnsafeDropTransferEF> This,
+                                      const EdgeFunction<l_t> &OtherFunction);
+
+        friend bool operator==(UnsafeDropTransferEF L, UnsafeDropTransferEF R) noexcept
+        {
+            return L.Transfer == R.Transfer;
+        }
+
+        friend llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, UnsafeDropTransferEF EF);
+    }; // struct UnsafeDropTransferEF
+
+    /**
+     * IDETypeStateAnalysis for UnsafeDropStateDescription with tabulated edge functions.
+     *
+     * The edge functions of the base analysis are replaced by the UnsafeDropTransferEF
+     * with the same values on all states, so equivalent edge functions are
+     * shared and composing and joining them during the solve does not allocate.
+     *
+     * The callees the description summarizes get a summary flow function that
+     * only passes the zero fact on, so the solver does not enter them and
+     * their calls only have the effect of the call-to-return flow.
+     */
+    class UnsafeDropTypeStateAnalysis : public IDETypeStateAnalysis<UnsafeDropStateDescription>
+    {
+    private:
+        using base_t = IDETypeStateAnalysis<UnsafeDropStateDescription>;
+
+        // on the heap, transfers point to their table and the problem may be moved
+        std::unique_ptr<UnsafeDropTransferTable> Transfers = std::make_unique<UnsafeDropTransferTable>();
+        const UnsafeDropStateDescription *Description;
+        // calls of the edge function factories by the solver
+        size_t NumEdgeFunctionQueries = 0;
+        // (call site, callee) pairs the solver did not enter
+        size_t NumSummarizedCalls = 0;
+
+        EdgeFunction<l_t> tabulated(EdgeFunction<l_t> EF) const;
+
+    public:
+        UnsafeDropTypeStateAnalysis(const LLVMProjectIRDB *IRDB, LLVMAliasInfoRef PT, const UnsafeDropStateDescription *TSD,
+                                    std::vector<std::string> EntryPoints = {"main"})
+            : base_t(IRDB, PT, TSD, std::move(EntryPoints)), Description(TSD)
+        {
+        }
+
+        FlowFunctionPtrType getSummaryFlowFunction(n_t CallSite, f_t DestFun) override;
+
+        EdgeFunction<l_t> getSummaryEdgeFunction(n_t CallSite, d_t CallNode, n_t RetSite, d_t RetSiteNode) override;
+
+        EdgeFunction<l_t> getNormalEdgeFunction(n_t Curr, d_t CurrNode, n_t Succ, d_t SuccNode) override;
+
+        EdgeFunction<l_t> getCallToRetEdgeFunction(n_t CallSite, d_t CallNode, n_t RetSite, d_t RetSiteNode,
+                                                   llvm::ArrayRef<f_t> Callees) override;
+
+        void printEdgeFunctionStats(llvm::raw_ostream &OS) const { Transfers->printStats(OS); }
+
+        [[nodiscard]] const UnsafeDropTransferTable &transfers() const { return *Transfers; }
+        [[nodiscard]] size_t numEdgeFunctionQueries() const { return NumEdgeFunctionQueries; }
+        [[nodiscard]] size_t numSummarizedCalls() const { return NumSummarizedCalls; }
+    }; // class UnsafeDropTypeStateAnalysis
+
+} // namespace psr
+
+#endif // UNSAFE_DROP_TYPE_STATE_ANALYSIS_H
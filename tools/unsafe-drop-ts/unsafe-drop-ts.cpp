@@ -9,7 +9,10 @@
 
 #include "phasar.h"
 #include "llvm/IR/DebugInfo.h"
-#include "UnsafeDropStateDescription.h"
+#include "BatchRunner.h"
+#include "TypeStateRun.h"
+#include "AnalysisCache.h"
+#include "Instrumentation.h"
 
 #include <filesystem>
 #include <string>
@@ -26,270 +29,221 @@ void print_usage()
   llvm::errs() << "unsafe-drop-ts \n"
                   "A small PhASAR-based program to check for unsafe drops using typestate analysis\n\n"
                   "Usage: unsafe-drop-ts <LLVM IR file> <FLAGS...>\n"
+                  "       unsafe-drop-ts --batch <manifest> <FLAGS...>\n"
                   "FLAGS:\n"
                   "--help\n"
-                  "--debug-log\n";
+                  "--debug-log\n"
+                  "--findings <path>      write DF/UAF findings as JSON Lines to <path>, not '-', stdout gets the report\n"
+                  "--full-dump            print the full IDE results and all value / state pairs of each run\n"
+                  "--stats <path>         write a JSON summary of the time and memory used per phase and of the\n"
+                  "                       solver counters to <path>, '-' for stdout\n"
+                  "--cache-dir <dir>      reuse parsed IR, call graph, points-to sets and parsed Rust sources\n"
+                  "                       stored in <dir> across runs\n"
+                  "--slice-unsafe         only solve the functions that can reach or be reached from unsafe code\n"
+                  "--analyze-std          also solve the functions of core, alloc and std instead of relying on\n"
+                  "                       their summaries at the call sites\n"
+                  "--incremental <state>  only solve functions whose IR changed since the run that wrote <state>\n"
+                  "                       and their transitive callers, reuse the stored results for all others\n"
+                  "                       and update <state>\n"
+                  "--parallel-runs        solve both typestate runs concurrently over the same helper analyses\n"
+                  "--engine <E>           typestate solver: 'ide' (default), 'bitvector' for the gen/kill engine\n"
+                  "                       with bottom-up callee summaries, 'both' to run both and report where\n"
+                  "                       they differ,\n"
+                  "                       'demand' to only answer backward queries at the drop and unsafe construct\n"
+                  "                       call sites and at the uses of the values they release, or 'all' to run\n"
+                  "                       all three and report where\n"
+                  "                       the bit-vector and demand findings differ from the IDE ones\n"
+                  "--batch <manifest>     analyze every LLVM IR file listed in <manifest>, one per line\n"
+                  "--jobs <N>             number of files analyzed in parallel in batch mode (default: all cores)\n"
+                  "--mem-limit-mb <MiB>   per file address space limit in batch mode (default: unlimited)\n"
+                  "--timeout-s <S>        per file wall clock limit in batch mode (default: unlimited)\n"
+                  "--output-dir <dir>     per file logs and batch-results.jsonl in batch mode (default: psr-output)\n";
 }
 
-struct Opts
+struct Opts : TypeStateOptions
 {
   std::string file;
-  bool debug_log;
+  std::string stats_file;
+  BatchOptions batch;
 };
 
 int usage(int argc, const char **argv, Opts *out_opts)
 {
   llvm::outs() << "unsafe-drop-ts\n\n";
-  if (argc < 2 || !std::filesystem::exists(argv[1]) ||
-      std::filesystem::is_directory(argv[1]))
-  {
-    print_usage();
-    return 1;
-  }
   for (int i = 1; i < argc; ++i)
   {
-    if (std::string(argv[i]) == std::string("--help"))
+    const std::string arg = argv[i];
+    if (arg == "--help")
     {
       print_usage();
       return 1;
     }
-    if (std::string(argv[i]) == std::string("--debug-log"))
+    if (arg == "--debug-log")
     {
       out_opts->debug_log = true;
+      out_opts->batch.per_file_args.push_back(arg);
+      continue;
     }
-  }
-  out_opts->file = std::string(argv[1]);
-  return 0;
-}
-
-llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, const std::set<UnsafeDropState> &S)
-{
-  OS << "[ ";
-  for (auto s : S)
-  {
-    OS << to_string(s) << ", ";
-  }
-  OS << "]";
-  return OS;
-}
-
-using ide_result_cells_t = std::vector<psr::Table<const llvm::Instruction *, const llvm::Value *, psr::UnsafeDropState>::Cell>;
-using run_result_t = std::map<const llvm::Value *, std::set<UnsafeDropState>>;
-using ide_results_t = psr::SolverResults<const llvm::Instruction *, const llvm::Value *, psr::UnsafeDropState>;
-
-// forward decls
-run_result_t cells_to_run_result(ide_result_cells_t &result_cells);
-run_result_t filter_run_result(run_result_t &run_result);
-
-class RunResult
-{
-public:
-  ide_results_t Ide_results;
-  ide_result_cells_t Ide_result_cells;
-  run_result_t Run_result_map;
-  run_result_t Run_result_map_filtered;
-  RunResult(ide_results_t Ide_results)
-      : Ide_results(Ide_results),
-        Ide_result_cells(Ide_results.getAllResultEntries()),
-        Run_result_map(cells_to_run_result(Ide_result_cells)),
-        Run_result_map_filtered(filter_run_result(Run_result_map)){};
-}; // class RunResult
-
-run_result_t cells_to_run_result(ide_result_cells_t &result_cells)
-{
-  run_result_t result_map = std::map<const llvm::Value *, std::set<UnsafeDropState>>();
-  for (auto cell : result_cells)
-  {
-    // auto llvm_value = cell.getRowKey();
-    auto llvm_value = cell.getColumnKey();
-    auto state = cell.getValue();
-    result_map[llvm_value].emplace(state);
-  }
-  return result_map;
-}
-
-run_result_t filter_run_result(run_result_t &run_result)
-{
-  auto result_map_filtered = std::map<const llvm::Value *, std::set<UnsafeDropState>>();
-  for (auto m : run_result)
-  {
-    if (!m.second.count(UnsafeDropState::TS_ERROR) &&
-        m.second != std::set({UnsafeDropState::BOT}) &&
-        m.second != std::set({UnsafeDropState::UNINIT}) &&
-        m.second != std::set({UnsafeDropState::BOT, UnsafeDropState::UNINIT}))
+    if (arg == "--full-dump")
     {
-      result_map_filtered.emplace(m.first, m.second);
+      out_opts->full_dump = true;
+      out_opts->batch.per_file_args.push_back(arg);
+      continue;
     }
-  }
-  return result_map_filtered;
-}
-
-void combine_results(HelperAnalyses &HA, const RunResult &run_1, const RunResult &run_2)
-{
-  std::unordered_set<const llvm::Value *> run_2_error_values;
-  for (const auto m : run_2.Run_result_map_filtered)
-  {
-    if (m.second.count(UnsafeDropState::DF_ERROR) || m.second.count(UnsafeDropState::UAF_ERROR))
+    if (arg == "--slice-unsafe")
     {
-      run_2_error_values.insert(m.first);
+      out_opts->slice_unsafe = true;
+      out_opts->batch.per_file_args.push_back(arg);
+      continue;
     }
-  }
-
-  std::unordered_set<const llvm::Value *> run_1_wrapped_values;
-  for (const auto m : run_1.Run_result_map_filtered)
-  {
-    if (m.second.count(UnsafeDropState::RAW_WRAPPED))
+    if (arg == "--analyze-std")
     {
-      run_1_wrapped_values.insert(m.first);
+      out_opts->analyze_std = true;
+      out_opts->batch.per_file_args.push_back(arg);
+      continue;
     }
-  }
-
-  auto description = UnsafeDropStateDescription(HA);
-
-  // TODO: implement
-  // this should for each value that ends in a DF/UAF error state
-  // find all values that are passed into the unsafeConstruct call
-  // where the value has been tagged as coming from getPtr and therefore is also in state RAW_WRAPPED
-
-  // FIXME: is this actually the correct logic????? dont we under approximate the problem with the general approach of 2 analysis
-
-  for (const auto instr : HA.getProjectIRDB().getAllInstructions())
-  {
-
-    // get run_2 value / state pairs for each instruction, filter by DF/UAF ERROR state
-
-    // SEGFAULT happens in this method call
-    // auto res_2 = run_2.Ide_results.resultsAtInLLVMSSA(instr, true, true);
-    // avoid calling resultsAtInLLVMSSA(instr), as it segfaults
-    // maybe instead call resultAtInLLVMSSA(instr) with each of the run_2_error_values
-    // avoid calling resultAtInLLVMSSA, as it also segfaults
-
-    // NOTE: the association of facts to the instruction mithgt be of by one,
-    // as the fact only holds after the instructions that introduced it.
-
-    std::unordered_map<const llvm::Value *, UnsafeDropState> res_2_filtered;
-    for (const auto cell : run_2.Ide_result_cells)
+    if (arg == "--engine")
     {
-      if (cell.getRowKey() != instr)
+      const llvm::StringRef value = i + 1 < argc ? argv[++i] : "";
+      if (value == "ide")
+      {
+        out_opts->engine = Engine::IDE;
+      }
+      else if (value == "bitvector")
       {
-        continue;
+        out_opts->engine = Engine::BITVECTOR;
       }
-      auto llvm_value = cell.getColumnKey();
-      auto state = cell.getValue();
-      if (run_2_error_values.count(llvm_value))
+      else if (value == "both")
       {
-        res_2_filtered.emplace(llvm_value, state);
+        out_opts->engine = Engine::BOTH;
       }
+      else if (value == "demand")
+      {
+        out_opts->engine = Engine::DEMAND;
+      }
+      else if (value == "all")
+      {
+        out_opts->engine = Engine::ALL;
+      }
+      else
+      {
+        llvm::errs() << "error: invalid value for " << arg << ": " << value << "\n";
+        print_usage();
+        return 1;
+      }
+      out_opts->batch.per_file_args.push_back(arg);
+      out_opts->batch.per_file_args.push_back(value.str());
+      continue;
     }
-
-    // get run_1 value / state pairs for each instruction, filter by RAW_WRAPPED state
-    // this might segfault
-    // auto res_1 = run_1.Ide_results.resultsAtInLLVMSSA(instr, true, true);
-
-    std::unordered_map<const llvm::Value *, UnsafeDropState> res_1_filtered;
-    for (const auto cell : run_1.Ide_result_cells)
+    if (arg == "--findings")
     {
-      if (cell.getRowKey() != instr)
+      // in batch mode every file gets its own findings file next to its log
+      if (i + 1 >= argc)
       {
-        continue;
+        print_usage();
+        return 1;
       }
-      auto llvm_value = cell.getColumnKey();
-      auto state = cell.getValue();
-      if (run_1_wrapped_values.count(llvm_value))
+      out_opts->findings_file = argv[++i];
+      // the findings would be interleaved with the report on stdout
+      if (out_opts->findings_file == "-")
       {
-        res_1_filtered.emplace(llvm_value, state);
+        llvm::errs() << "error: invalid value for " << arg << ": -\n";
+        print_usage();
+        return 1;
       }
+      continue;
     }
-
-    // merge the two sets on the value
-    std::unordered_map<const llvm::Value *, llvm::SmallSet<UnsafeDropState, 2>> joined;
-    for (const auto m_1 : res_1_filtered)
+    if (arg == "--stats")
     {
-      // operator[] will default construct an empty set value if not present
-      joined[m_1.first].insert(m_1.second);
+      // in batch mode every file gets its own summary next to its log
+      if (i + 1 >= argc)
+      {
+        print_usage();
+        return 1;
+      }
+      out_opts->stats_file = argv[++i];
+      continue;
     }
-    for (const auto m_2 : res_2_filtered)
+    if (arg == "--cache-dir")
     {
-      // operator[] will default construct an empty set value if not present
-      joined[m_2.first].insert(m_2.second);
+      if (i + 1 >= argc)
+      {
+        print_usage();
+        return 1;
+      }
+      out_opts->cache_dir = argv[++i];
+      out_opts->batch.per_file_args.push_back(arg);
+      out_opts->batch.per_file_args.push_back(out_opts->cache_dir);
+      continue;
     }
-
-    std::set<UnsafeDropState> all_states;
-    for (const auto m : joined)
+    if (arg == "--incremental")
     {
-      for (const auto s : m.second)
+      // not forwarded in batch mode, every file needs its own state
+      if (i + 1 >= argc)
       {
-        all_states.insert(s);
+        print_usage();
+        return 1;
       }
+      out_opts->incremental_state = argv[++i];
+      continue;
     }
-
-    // llvm::outs() << "States at instruction: " << *instr << " ==\n==> " << all_states << "\n";
-
-    // TODO: check if RAW_WRAPPED and error states exists at the same instruction of kind unsafeConstruct
-    // and RAW_WRAPPED is used as a arg
-    // FIXME: should check for arg
-
-    // TODO: do only compute when unsafeConstruct invoke or all instr
-    /*
-    if (description.funcNameToToken(llvm::demangle(???)) != UnsafeDropToken::UNSAFE_CONSTRUCT)
+    if (arg == "--parallel-runs")
     {
+      out_opts->parallel_runs = true;
+      out_opts->batch.per_file_args.push_back(arg);
       continue;
     }
-    */
-
-    if ((all_states.count(UnsafeDropState::DF_ERROR) || all_states.count(UnsafeDropState::UAF_ERROR)) && all_states.count(UnsafeDropState::RAW_WRAPPED))
+    if (arg == "--batch" || arg == "--jobs" || arg == "--mem-limit-mb" ||
+        arg == "--timeout-s" || arg == "--output-dir")
     {
-      llvm::outs() << "\n\nPotential error detected at instruction:\n    "
-                   << *instr
-                   << "\n Joined states: \n    ";
-      for (const auto m : joined)
+      if (i + 1 >= argc)
       {
-        llvm::outs() << *m.first << " ==> " << m.second << "\n";
+        print_usage();
+        return 1;
       }
+      const llvm::StringRef value = argv[++i];
+      bool err = false;
+      if (arg == "--batch")
+      {
+        out_opts->batch.manifest = value.str();
+      }
+      else if (arg == "--jobs")
+      {
+        err = value.getAsInteger(10, out_opts->batch.jobs);
+      }
+      else if (arg == "--mem-limit-mb")
+      {
+        err = value.getAsInteger(10, out_opts->batch.mem_limit_mb);
+      }
+      else if (arg == "--timeout-s")
+      {
+        err = value.getAsInteger(10, out_opts->batch.timeout_s);
+      }
+      else if (arg == "--output-dir")
+      {
+        out_opts->batch.output_dir = value.str();
+      }
+      if (err)
+      {
+        llvm::errs() << "error: invalid value for " << arg << ": " << value << "\n";
+        print_usage();
+        return 1;
+      }
+      continue;
+    }
+    if (out_opts->file.empty() && !llvm::StringRef(arg).startswith("--"))
+    {
+      out_opts->file = arg;
     }
   }
-
-  return;
-}
-
-RunResult run_analysis_once(HelperAnalyses &HA, const std::vector<std::string> &entrypoints, const bool unsafe_construct_as_factory, const bool dump_results)
-{
-
-  llvm::outs() << "Creating problem description and solver\n";
-  const auto ts_description = UnsafeDropStateDescription(HA, unsafe_construct_as_factory);
-  auto ide_ts_problem = createAnalysisProblem<IDETypeStateAnalysis<UnsafeDropStateDescription>>(HA, &ts_description, entrypoints);
-  auto ide_solver = IDESolver(ide_ts_problem, &HA.getICFG());
-  llvm::outs() << "Solving IDE problem\n";
-  auto ide_results = ide_solver.solve();
-  llvm::outs() << "IDE results:\n\n";
-  if (dump_results)
-  {
-    ide_results.dumpResults(HA.getICFG());
-  }
-  else
-  {
-    llvm::outs() << "(IDE results skipped)\n";
-  }
-
-  llvm::outs() << "Collected results:\n\n";
-
-  const auto run_result = RunResult(ide_results);
-
-  for (const auto m : run_result.Run_result_map)
-  {
-    llvm::outs() << *m.first << " ==> " << m.second << "\n";
-  }
-
-  return run_result;
-}
-
-void print_run_result(run_result_t &run_result)
-{
-  llvm::outs() << "\n\n###########\n\nFiltered run results:\n\n";
-  for (auto m : run_result)
+  const std::string &input = out_opts->batch.manifest.empty() ? out_opts->file : out_opts->batch.manifest;
+  if (input.empty() || !std::filesystem::exists(input) ||
+      std::filesystem::is_directory(input))
   {
-    llvm::outs() << *m.first << " ==> " << m.second << "\n";
+    print_usage();
+    return 1;
   }
+  return 0;
 }
 
 int main(int argc, const char **argv)
@@ -323,93 +277,21 @@ int main(int argc, const char **argv)
     Logger::initializeStderrLogger(psr::SeverityLevel::INFO);
   }
 
-  // const std::vector entrypoints = {"main"s};
-  const std::vector entrypoints = {"__ALL__"s};
-  HelperAnalyses HA(IRFile, entrypoints);
-
-  /* skip main check for now
-  const auto *F = HA.getProjectIRDB().getFunctionDefinition("main");
-  if (!F)
+  if (!opts.stats_file.empty())
   {
-    PHASAR_LOG_LEVEL(CRITICAL, "error: file does not contain a 'main' function!");
-    return 1;
-  }*/
-
-  llvm::outs() << "\n\n###########\n\n First Run (unsafe_construct_as_factory=false):\n\n";
-  auto run_1 = run_analysis_once(HA, entrypoints, false, opts.debug_log);
-  if (opts.debug_log)
-  {
-    print_run_result(run_1.Run_result_map_filtered);
-  }
-  else
-  {
-    llvm::outs() << "(output skipped)\n";
+    Instrumentation::global().enableSummary("unsafe-drop-ts", opts.stats_file);
   }
 
-  llvm::outs() << "\n\n###########\n\n Second Run (unsafe_construct_as_factory=true):\n\n";
-  auto run_2 = run_analysis_once(HA, entrypoints, true, opts.debug_log);
-  if (opts.debug_log)
+  if (!opts.batch.manifest.empty())
   {
-    print_run_result(run_2.Run_result_map_filtered);
+    auto phase = Instrumentation::global().phase("batch");
+    return run_batch(opts.batch);
   }
-  else
-  {
-    llvm::outs() << "(output skipped)\n";
-  }
-
-  llvm::outs() << "\n\n###########\n\nResults with DF/UAF Errors:\n\n";
-  for (auto m : run_2.Run_result_map_filtered)
-  {
-    if (m.second.count(UnsafeDropState::DF_ERROR) || m.second.count(UnsafeDropState::UAF_ERROR))
-    {
-      llvm::outs() << *m.first << " ==> " << m.second << "\n";
-    }
-  }
-
-  llvm::outs() << "\n\n###########\n\nResults with DF/UAF Errors that have also been RAW_WRAPPED or RAW_REFERENCED:\n\n";
-  for (auto m : run_2.Run_result_map_filtered)
-  {
-    if (
-        (m.second.count(UnsafeDropState::DF_ERROR) || m.second.count(UnsafeDropState::UAF_ERROR)) && (m.second.count(UnsafeDropState::RAW_REFERENCED) || m.second.count(UnsafeDropState::RAW_WRAPPED)))
-    {
-      llvm::outs() << *m.first << " ==> " << m.second << "\n";
-    }
-  }
-
-  // check with values from first run aswell by joining the two runs on the value
 
-  run_result_t merged_result;
-  for (const auto m_1 : run_1.Run_result_map_filtered)
-  {
-    for (const auto s : m_1.second)
-    {
-      // operator[] will default construct an empty set value if not present
-      merged_result[m_1.first].insert(s);
-    }
-  }
-  for (const auto m_2 : run_2.Run_result_map_filtered)
-  {
-    for (const auto s : m_2.second)
-    {
-      // operator[] will default construct an empty set value if not present
-      merged_result[m_2.first].insert(s);
-    }
-  }
-
-  llvm::outs() << "\n\n###########\n\n===Merged=== Results with DF/UAF Errors that have also been RAW_WRAPPED or RAW_REFERENCED:\n\n";
-  for (auto m : run_2.Run_result_map_filtered)
-  {
-    if (
-        (m.second.count(UnsafeDropState::DF_ERROR) || m.second.count(UnsafeDropState::UAF_ERROR)) && (m.second.count(UnsafeDropState::RAW_REFERENCED) || m.second.count(UnsafeDropState::RAW_WRAPPED)))
-    {
-      llvm::outs() << *m.first << " ==> " << m.second << "\n";
-    }
-  }
-
-  llvm::outs() << "\n\n###########\n\nCombined results:\n\n";
-  llvm::outs() << "(skipped)\n";
-  // combine_results(HA, run_1, run_2);
+  // const std::vector entrypoints = {"main"s};
+  const std::vector entrypoints = {"__ALL__"s};
+  auto HA_ptr = load_helper_analyses(IRFile, entrypoints, opts.cache_dir);
+  auto &HA = *HA_ptr;
 
-  llvm::outs() << "Done.\n\n";
-  return 0;
-}
\ No newline at end of file
+  return run_typestate(HA, entrypoints, opts);
+}
@@ -0,0 +1,325 @@
+/******************************************************************************
+ * Copyright (c) 2023 Felix Stegmaier.
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of LICENSE.txt.
+ *
+ * Contributors:
+ *  Template of `myphasartool` by Philipp Schubert and others under MIT License
+ *****************************************************************************/
+
+#include "phasar.h"
+#include "llvm/ADT/StringRef.h"
+#include "AnalysisCache.h"
+#include "DemangleCache.h"
+#include "DoubleLeaks.h"
+#include "Instrumentation.h"
+#include "TaintConfigs.h"
+#include "TaintEngines.h"
+#include "TaskGraph.h"
+#include "TypeStateRun.h"
+#include "UnsafeFunctions.h"
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+
+using namespace psr;
+
+const std::vector<std::string> all_analyses = {"typestate", "alloc-taint", "unsafe-taint", "double-leak"};
+
+void print_usage()
+{
+  llvm::errs() << "unsafe-rs-analyzer \n"
+                  "A PhASAR-based program running the unsafe drop analyses on one module\n\n"
+                  "Usage: unsafe-rs-analyzer <LLVM IR file> <FLAGS...>\n"
+                  "FLAGS:\n"
+                  "--help\n"
+                  "--analyses <A,...>      comma separated subset of typestate, alloc-taint, unsafe-taint and\n"
+                  "                        double-leak (default: all)\n"
+                  "--cache-dir <dir>       reuse parsed IR, call graph, points-to sets and parsed Rust sources\n"
+                  "                        stored in <dir> across runs\n"
+                  "--stats <path>          write a JSON summary of the time and memory used per analysis and of the\n"
+                  "                        solver counters to <path>, '-' for stdout\n"
+                  "--alloc-config <path>   taint config of alloc-taint and double-leak instead of the built-in one,\n"
+                  "                        may be given multiple times\n"
+                  "--unsafe-config <path>  taint config of unsafe-taint instead of the built-in one,\n"
+                  "                        may be given multiple times\n"
+                  "--sequential            solve the IFDS and IDE taint problems one after the other\n"
+                  "--taint-std-summaries   apply the std summaries at the calls into std in the IFDS taint problem,\n"
+                  "                        the IDE taint problem has none, so their leaks are not compared\n"
+                  "typestate FLAGS, see unsafe-drop-ts:\n"
+                  "--debug-log --full-dump --slice-unsafe --analyze-std --parallel-runs\n"
+                  "--findings <path> --engine <ide|bitvector|both|demand|all> --incremental <state>\n";
+}
+
+struct Opts : TypeStateOptions
+{
+  std::string file;
+  std::vector<std::string> analyses = all_analyses;
+  std::string stats_file;
+  std::vector<std::string> alloc_configs;
+  std::vector<std::string> unsafe_configs;
+  bool sequential = false;
+  bool taint_std_summaries = false;
+};
+
+int usage(int argc, const char **argv, Opts *out_opts)
+{
+  llvm::outs() << "unsafe-rs-analyzer\n\n";
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if (arg == "--help")
+    {
+      print_usage();
+      return 1;
+    }
+    if (arg == "--debug-log")
+    {
+      out_opts->debug_log = true;
+      continue;
+    }
+    if (arg == "--full-dump")
+    {
+      out_opts->full_dump = true;
+      continue;
+    }
+    if (arg == "--slice-unsafe")
+    {
+      out_opts->slice_unsafe = true;
+      continue;
+    }
+    if (arg == "--analyze-std")
+    {
+      out_opts->analyze_std = true;
+      continue;
+    }
+    if (arg == "--parallel-runs")
+    {
+      out_opts->parallel_runs = true;
+      continue;
+    }
+    if (arg == "--sequential")
+    {
+      out_opts->sequential = true;
+      continue;
+    }
+    if (arg == "--taint-std-summaries")
+    {
+      out_opts->taint_std_summaries = true;
+      continue;
+    }
+    if (llvm::StringRef(arg).startswith("--"))
+    {
+      // all other flags take a value
+      if (i + 1 >= argc)
+      {
+        print_usage();
+        return 1;
+      }
+      const llvm::StringRef value = argv[++i];
+      bool err = false;
+      if (arg == "--analyses")
+      {
+        llvm::SmallVector<llvm::StringRef, 4> names;
+        value.split(names, ',', -1, /* KeepEmpty */ false);
+        out_opts->analyses.clear();
+        for (const auto name : names)
+        {
+          err |= llvm::find(all_analyses, name.trim()) == all_analyses.end();
+          out_opts->analyses.push_back(name.trim().str());
+        }
+      }
+      else if (arg == "--engine")
+      {
+        if (value == "ide")
+        {
+          out_opts->engine = Engine::IDE;
+        }
+        else if (value == "bitvector")
+        {
+          out_opts->engine = Engine::BITVECTOR;
+        }
+        else if (value == "both")
+        {
+          out_opts->engine = Engine::BOTH;
+        }
+        else if (value == "demand")
+        {
+          out_opts->engine = Engine::DEMAND;
+        }
+        else if (value == "all")
+        {
+          out_opts->engine = Engine::ALL;
+        }
+        else
+        {
+          err = true;
+        }
+      }
+      else if (arg == "--cache-dir")
+      {
+        out_opts->cache_dir = value.str();
+      }
+      else if (arg == "--stats")
+      {
+        out_opts->stats_file = value.str();
+      }
+      else if (arg == "--findings")
+      {
+        // the findings would be interleaved with the report on stdout
+        err = value == "-";
+        out_opts->findings_file = value.str();
+      }
+      else if (arg == "--incremental")
+      {
+        out_opts->incremental_state = value.str();
+      }
+      else if (arg == "--alloc-config")
+      {
+        out_opts->alloc_configs.push_back(value.str());
+      }
+      else if (arg == "--unsafe-config")
+      {
+        out_opts->unsafe_configs.push_back(value.str());
+      }
+      else
+      {
+        llvm::errs() << "error: unknown flag " << arg << "\n";
+        print_usage();
+        return 1;
+      }
+      if (err)
+      {
+        llvm::errs() << "error: invalid value for " << arg << ": " << value << "\n";
+        print_usage();
+        return 1;
+      }
+      continue;
+    }
+    if (out_opts->file.empty())
+    {
+      out_opts->file = arg;
+    }
+  }
+  if (out_opts->file.empty() || !std::filesystem::exists(out_opts->file) ||
+      std::filesystem::is_directory(out_opts->file))
+  {
+    print_usage();
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, const char **argv)
+{
+  using namespace std::string_literals;
+
+  Opts opts;
+  if (const int err = usage(argc, argv, &opts))
+  {
+    PHASAR_LOG_LEVEL(CRITICAL, "error: incorrect usage");
+    return err;
+  }
+
+  Logger::initializeStderrLogger(opts.debug_log ? psr::SeverityLevel::DEBUG : psr::SeverityLevel::INFO);
+
+  if (!opts.stats_file.empty())
+  {
+    Instrumentation::global().enableSummary("unsafe-rs-analyzer", opts.stats_file);
+  }
+
+  // the module, call graph and points-to sets are loaded once and shared by all analyses,
+  // the typestate analysis needs all functions, the taint analyses start from main
+  const std::vector entrypoints = {"__ALL__"s};
+  auto HA_ptr = load_helper_analyses(opts.file, entrypoints, opts.cache_dir);
+  auto &HA = *HA_ptr;
+
+  TaintRunOptions taint_opts;
+  taint_opts.Parallel = !opts.sequential;
+  taint_opts.StdSummaries = opts.taint_std_summaries;
+
+  // results of the pre-passes and analyses, filled in by the tasks that compute them
+  std::optional<FunctionNameIndex> function_index;
+  std::optional<UnsafeCode> unsafe_code;
+  std::map<std::string, TaintEngineLeaks> alloc_leaks;
+
+  auto has_main = [&]
+  {
+    if (!HA.getProjectIRDB().getFunctionDefinition("main"))
+    {
+      PHASAR_LOG_LEVEL(CRITICAL, "error: file does not contain a 'main' function, the taint analyses are skipped!");
+      return false;
+    }
+    return true;
+  };
+
+  TaskGraph tasks;
+  tasks.add("function_index", {}, [&]
+            {
+              function_index.emplace(HA.getICFG().getAllFunctions());
+              return true; });
+  tasks.add("unsafe_code", {}, [&]
+            {
+              unsafe_code = find_unsafe_code(HA.getICFG().getAllFunctions(), &llvm::outs(), opts.cache_dir);
+              llvm::outs() << "\nUnsafe functions (" << unsafe_code->Instructions.size() << " unsafe instructions):\n";
+              for (const auto *f : unsafe_code->Functions)
+              {
+                llvm::outs() << f->getName() << " (" << DemangleCache::global().demangle(f) << ")\n";
+              }
+              return true; });
+  tasks.add("typestate", opts.slice_unsafe ? std::vector{"unsafe_code"s} : std::vector<std::string>{}, [&]
+            {
+              llvm::outs() << "\n\n###########\n\nTypestate analysis:\n\n";
+              return run_typestate(HA, entrypoints, opts, unsafe_code ? &*unsafe_code : nullptr) == 0; });
+  tasks.add("alloc-taint", {"function_index"}, [&]
+            {
+              if (!has_main())
+              {
+                return false;
+              }
+              auto configs = taint_configs(opts.alloc_configs, alloc_taint_config, *function_index);
+              if (!configs)
+              {
+                return false;
+              }
+              for (const auto &[config_name, taint_config_data] : *configs)
+              {
+                llvm::outs() << "\n\n###########\n\nAlloc taint config " << config_name << ":\n\n";
+                alloc_leaks[config_name] = run_taint_config(HA, "alloc/" + config_name, taint_config_data, nullptr, taint_opts, llvm::outs());
+              }
+              return true; });
+  tasks.add("unsafe-taint", {"function_index", "unsafe_code"}, [&]
+            {
+              if (!has_main())
+              {
+                return false;
+              }
+              auto configs = taint_configs(opts.unsafe_configs, unsafe_taint_config, *function_index);
+              if (!configs)
+              {
+                return false;
+              }
+              for (const auto &[config_name, taint_config_data] : *configs)
+              {
+                llvm::outs() << "\n\n###########\n\nUnsafe taint config " << config_name << ":\n\n";
+                run_taint_config(HA, "unsafe/" + config_name, taint_config_data, &*unsafe_code, taint_opts, llvm::outs());
+              }
+              return true; });
+  tasks.add("double-leak", {"alloc-taint"}, [&]
+            {
+              for (const auto &[config_name, leaks] : alloc_leaks)
+              {
+                llvm::outs() << "\n\n###########\n\nDouble leaks of alloc taint config " << config_name << ":\n\n";
+                llvm::outs() << "Double leaks found using IFDS Taint:\n";
+                print_double_leaks(find_double_leaks(leaks.IFDS, &HA.getAliasInfo()), llvm::outs());
+                llvm::outs() << "Double leaks found using IDE XTaint:\n";
+                print_double_leaks(find_double_leaks(leaks.IDEXTaint, &HA.getAliasInfo()), llvm::outs());
+              }
+              return true; });
+
+  const bool ok = tasks.run(opts.analyses, llvm::errs());
+  llvm::outs() << "Done.\n\n";
+  return ok ? 0 : 1;
+}
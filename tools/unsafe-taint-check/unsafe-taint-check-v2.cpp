@@ -7,8 +7,14 @@
  *  Template of `myphasartool` by Philipp Schubert and others under MIT License
  *****************************************************************************/
 
-#include "find_unsafe_rs.h"
 #include "phasar.h"
+#include "AnalysisCache.h"
+#include "Instrumentation.h"
+#include "TaintEngines.h"
+#include "DemangleCache.h"
+#include "DoubleLeaks.h"
+#include "TaintConfigs.h"
+#include "UnsafeFunctions.h"
 #include "llvm/IR/DebugInfo.h"
 
 #include <filesystem>
@@ -17,78 +23,23 @@
 
 using namespace psr;
 
-/// @brief Find all functions in the module that are marked as `unsafe`. Uses find_unsafe_rs.
-/// @param HA
-std::vector<llvm::Function const *> get_unsafe_functions(HelperAnalyses &HA)
+/// @brief Run the IFDS and IDE taint analyses with one taint config
+void run_taint_analyses(HelperAnalyses &HA, const std::string &config_name, const TaintConfigData &taint_config_data, const UnsafeCode &unsafe_code, const bool parallel)
 {
-  auto *find_unsafe_rs = find_unsafe_rs_new();
-  std::vector<llvm::Function const *> unsafe_functions;
-  llvm::outs() << "\nDeclared functions [safety]:";
-  for (const llvm::Function *const f : HA.getICFG().getAllFunctions())
-  {
-    if (f->getName() == "llvm.dbg.declare")
-    {
-      continue;
-    }
-    const llvm::DISubprogram *const sub = f->getSubprogram();
-    if (!sub)
-    {
-      continue;
-    }
-
-    auto path = std::filesystem::path(sub->getDirectory().str()) / sub->getFilename().str();
-    int is_unsafe = 0;
-    // FIXME: using col=1000 here is very hacky
-    int err = find_unsafe_rs_is_any_unsafe_location(
-        find_unsafe_rs, path.c_str(), sub->getLine(), 1000, &is_unsafe);
-    if (err)
-    {
-      PHASAR_LOG_LEVEL(WARNING, "Error in file " << path.string() << " (error " << err << " ): " << strerror(err));
-      continue;
-    }
-    llvm::outs()
-        << f->getName()
-        << " ('" << sub->getName() << "')"
-        << " : " << path.string() << ":"
-        << sub->getLine() << " ["
-        << (is_unsafe ? "unsafe" : "safe")
-        << "]\n";
-    if (is_unsafe)
-    {
-      unsafe_functions.push_back(f);
-    }
-  }
-  find_unsafe_rs_free(find_unsafe_rs);
-  return unsafe_functions;
-}
+  TaintRunOptions opts;
+  opts.Parallel = parallel;
+  const auto leaks = run_taint_config(HA, config_name, taint_config_data, &unsafe_code, opts, llvm::outs());
 
-/// @brief Convert IFDS leak map to XTaint leak map for uniform data structure
-psr::XTaint::LeakMap_t convert_leaks(std::map<const llvm::Instruction *, std::set<const llvm::Value *>> &leaks)
-{
-  auto map = psr::XTaint::LeakMap_t();
-  for (const auto l : leaks)
-  {
-    auto set = llvm::SmallSet<const llvm::Value *, 1U>();
-    for (const auto v : l.second)
-    {
-      set.insert(v);
-    }
-    map.emplace(std::make_pair(l.first, set));
-  }
-  return map;
+  PHASAR_LOG_LEVEL(INFO, "Checking for double leak of values:\n");
+  print_double_leaks(find_double_leaks(leaks.IDEXTaint, &HA.getAliasInfo()), llvm::outs());
 }
 
-void print_leaks(psr::XTaint::LeakMap_t &leaks)
+void print_usage()
 {
-  for (const auto l : leaks)
-  {
-    llvm::outs() << "IR: " << *l.first << " -> Leaks values: \n";
-    for (const auto v : l.second)
-    {
-      llvm::outs() << " -> Value: " << *v << "\n";
-    }
-  }
-  llvm::outs() << "\n";
+  llvm::errs() << "unsafe-taint-check \n"
+                  "A small PhASAR-based program to check the unsafe taint for rust\n\n"
+                  "Usage: unsafe-taint-check <LLVM IR file> [--cache-dir <dir>] [--config <taint config>...] [--stats <path>] [--sequential]\n"
+                  "--sequential solves the IFDS and IDE taint problems one after the other instead of in parallel\n";
 }
 
 int main(int argc, const char **argv)
@@ -102,165 +53,85 @@ int main(int argc, const char **argv)
   if (argc < 2 || !std::filesystem::exists(argv[1]) ||
       std::filesystem::is_directory(argv[1]))
   {
-    llvm::errs() << "unsafe-taint-check \n"
-                    "A small PhASAR-based program to check the unsafe taint for rust\n\n"
-                    "Usage: unsafe-taint-check <LLVM IR file>\n";
+    print_usage();
     return 1;
   }
 
   std::vector entrypoints = {"main"s};
 
-  HelperAnalyses HA(argv[1], entrypoints);
-
-  const auto *F = HA.getProjectIRDB().getFunctionDefinition("main");
-  if (!F)
-  {
-    PHASAR_LOG_LEVEL(CRITICAL, "error: file does not contain a 'main' function!");
-    return 1;
-  }
-
-  // HA.getICFG().print();
-  auto unsafe_functions = get_unsafe_functions(HA);
-  llvm::outs() << "\nUnsafe functions:\n";
-  for (auto f : unsafe_functions)
-  {
-    llvm::outs() << f->getName() << "\n";
-  }
-
-  PHASAR_LOG_LEVEL(INFO, "Testing IFDS taint analysis with unsafe functions as source:");
-
-  TaintConfigData taint_config_data;
-  for (auto f : unsafe_functions)
+  std::string cache_dir;
+  std::vector<std::string> config_files;
+  std::string stats_file;
+  bool parallel = true;
+  for (int i = 2; i < argc; ++i)
   {
-    // all sret(%Type) marked arguments are considered return values and therefore tainted
-    // fill vec<int> with int if f->args()[i].getParamStructRetType() != NULL
-    std::vector<unsigned int> sretArgs;
-    unsigned int arg_num = 0;
-    for (auto &arg : f->args())
+    if (argv[i] == "--sequential"s)
     {
-      if (arg.hasStructRetAttr())
-      {
-        sretArgs.push_back(arg_num);
-      }
-      arg_num++;
+      parallel = false;
+      continue;
     }
-
-    taint_config_data.Functions.push_back(
-        FunctionData{
-            .Name = f->getName().str(),
-            .ReturnCat = TaintCategory::Source,
-            .SourceValues = sretArgs,
-        });
-  }
-  taint_config_data.Functions.push_back(
-      FunctionData{
-          .Name = "sink",
-          .HasAllSinkParam = true,
-      });
-  taint_config_data.Functions.push_back(
-      FunctionData{
-          .Name = "__rust_alloc",
-          .ReturnCat = TaintCategory::Source,
-      });
-  taint_config_data.Functions.push_back(
-      FunctionData{
-          .Name = "__rust_alloc_zeroed",
-          .ReturnCat = TaintCategory::Source,
-      });
-  // set all drop implementations as sinks
-  for (const llvm::Function *const f : HA.getICFG().getAllFunctions())
-  {
-    const llvm::DISubprogram *const sub = f->getSubprogram();
-    if (!sub)
+    // all other flags take a value
+    if (i + 1 >= argc)
     {
-      continue;
+      print_usage();
+      return 1;
     }
-    auto name = sub->getName().split("<").first;
-    if (name.contains("drop"))
+    if (argv[i] == "--cache-dir"s)
     {
-      PHASAR_LOG_LEVEL(INFO, "drop implementation found (w/o <...>): " << name);
-      taint_config_data.Functions.push_back(
-          FunctionData{
-              .Name = sub->getLinkageName().str(),
-              .HasAllSinkParam = true,
-          });
+      cache_dir = argv[++i];
+    }
+    else if (argv[i] == "--config"s)
+    {
+      config_files.push_back(argv[++i]);
+    }
+    else if (argv[i] == "--stats"s)
+    {
+      stats_file = argv[++i];
+    }
+    else
+    {
+      print_usage();
+      return 1;
     }
   }
+  if (!stats_file.empty())
+  {
+    Instrumentation::global().enableSummary("unsafe-taint-check-v2", stats_file);
+  }
 
-  LLVMTaintConfig taint_config(HA.getProjectIRDB(), taint_config_data);
-  llvm::outs() << "taint config:\n"
-               << taint_config << "\n";
-
-  IFDSTaintAnalysis ifds_taint_problem(&HA.getProjectIRDB(), &HA.getAliasInfo(), &taint_config);
-
-  PHASAR_LOG_LEVEL(INFO, "Solving IFDSTaintAnalysis taint problem");
-  IFDSSolver S(ifds_taint_problem, &HA.getICFG());
-  auto IFDSResults = S.solve();
-  // IFDSResults.dumpResults(HA.getICFG());
-
-  auto ifds_taint_leaks = convert_leaks(ifds_taint_problem.Leaks);
-  llvm::outs() << "\n"
-               << ifds_taint_leaks.size()
-               << " leaks found using IFDS Taint:\n";
-  print_leaks(ifds_taint_leaks);
-
-  PHASAR_LOG_LEVEL(INFO, "Testing IDE extended taint analysis with unsafe functions as source:");
-
-  const std::vector<std::string> entry_points = {"main"};
-  auto ide_xtaint_problem =
-      createAnalysisProblem<IDEExtendedTaintAnalysis<>>(HA, taint_config, entry_points);
-
-  PHASAR_LOG_LEVEL(INFO, "Solving IDEXTaintAnalysis taint problem");
-  IDESolver IDE_S(ide_xtaint_problem, &HA.getICFG());
-  auto IDEResults = IDE_S.solve();
-
-  auto ide_xtaint_leaks = ide_xtaint_problem.getAllLeaks(IDEResults);
-  llvm::outs() << "\n"
-               << ide_xtaint_leaks.size()
-               << " leaks found using IDE XTaint:\n";
-  print_leaks(ide_xtaint_leaks);
+  auto HA_ptr = load_helper_analyses(argv[1], entrypoints, cache_dir);
+  auto &HA = *HA_ptr;
 
-  // check for a value that is leaked twice
-  PHASAR_LOG_LEVEL(INFO, "Checking for double leak of values:\n");
+  const auto *F = HA.getProjectIRDB().getFunctionDefinition("main");
+  if (!F)
+  {
+    PHASAR_LOG_LEVEL(CRITICAL, "error: file does not contain a 'main' function!");
+    return 1;
+  }
 
-  auto leaked_values = llvm::DenseSet<const llvm::Value *>();
-  for (const auto leak : ide_xtaint_leaks)
+  // HA.getICFG().print();
+  const auto unsafe_code = find_unsafe_code(HA.getICFG().getAllFunctions(), &llvm::outs(), cache_dir);
+  llvm::outs() << "\nUnsafe functions (" << unsafe_code.Instructions.size() << " unsafe instructions):\n";
+  for (auto f : unsafe_code.Functions)
   {
-    for (const auto value : leak.second)
-    {
-      leaked_values.insert(value);
-    }
+    llvm::outs() << f->getName() << " (" << DemangleCache::global().demangle(f) << ")\n";
   }
 
-  auto leaks_per_value = llvm::DenseMap<const llvm::Value *, llvm::SmallSet<const llvm::Instruction *, 2U>>();
-  for (const auto value : leaked_values)
+  PHASAR_LOG_LEVEL(INFO, "Testing IFDS taint analysis with unsafe functions as source:");
+
+  // the name index is built once, all configs are analyzed on the same module
+  const FunctionNameIndex function_index(HA.getICFG().getAllFunctions());
+  const auto configs = taint_configs(config_files, unsafe_taint_config, function_index);
+  if (!configs)
   {
-    auto instructions = llvm::SmallSet<const llvm::Instruction *, 2U>();
-    for (auto const leak : ide_xtaint_leaks)
-    {
-      if (leak.second.contains(value))
-      {
-        instructions.insert(leak.first);
-      }
-    }
-    leaks_per_value.insert(std::make_pair(value, instructions));
+    return 1;
   }
 
-  for (const auto value_instrs : leaks_per_value)
+  for (const auto &[config_name, taint_config_data] : *configs)
   {
-    if (value_instrs.second.size() >= 2)
-    {
-      llvm::outs() << "Value: " << *value_instrs.first << "\n"
-                   << "is leaked multiple times by instructions: \n";
-      for (auto const instr : value_instrs.second)
-      {
-        llvm::outs() << " -> " << *instr << " ( Opcode = " << instr->getOpcodeName() << " ) \n";
-        if (auto const *cb = llvm::dyn_cast<llvm::CallBase>(instr))
-          llvm::outs() << *cb << " => called function: " << cb->getCalledFunction()->getName() << "\n";
-      }
-      llvm::outs() << "\n";
-    }
+    llvm::outs() << "\n\n###########\n\nTaint config " << config_name << ":\n\n";
+    run_taint_analyses(HA, config_name, taint_config_data, unsafe_code, parallel);
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -7,8 +7,13 @@
  *  Template of `myphasartool` by Philipp Schubert and others under MIT License
  *****************************************************************************/
 
-#include "find_unsafe_rs.h"
 #include "phasar.h"
+#include "AnalysisCache.h"
+#include "Instrumentation.h"
+#include "TaintEngines.h"
+#include "DemangleCache.h"
+#include "TaintConfigs.h"
+#include "UnsafeFunctions.h"
 #include "llvm/IR/DebugInfo.h"
 
 #include <filesystem>
@@ -17,78 +22,32 @@
 
 using namespace psr;
 
-/// @brief Find all functions in the module that are marked as `unsafe`. Uses find_unsafe_rs.
-/// @param HA
-std::vector<llvm::Function const *> get_unsafe_functions(HelperAnalyses &HA)
+/// @brief Built-in taint config, used if no --config is given
+TaintConfigData default_taint_config()
 {
-  auto *find_unsafe_rs = find_unsafe_rs_new();
-  std::vector<llvm::Function const *> unsafe_functions;
-  llvm::outs() << "\nDeclared functions [safety]:";
-  for (const llvm::Function *const f : HA.getICFG().getAllFunctions())
-  {
-    if (f->getName() == "llvm.dbg.declare")
-    {
-      continue;
-    }
-    const llvm::DISubprogram *const sub = f->getSubprogram();
-    if (!sub)
-    {
-      continue;
-    }
-
-    auto path = std::filesystem::path(sub->getDirectory().str()) / sub->getFilename().str();
-    int is_unsafe = 0;
-    // FIXME: using col=1000 here is very hacky
-    int err = find_unsafe_rs_is_any_unsafe_location(
-        find_unsafe_rs, path.c_str(), sub->getLine(), 1000, &is_unsafe);
-    if (err)
-    {
-      PHASAR_LOG_LEVEL(WARNING, "Error in file " << path.string() << " (error " << err << " ): " << strerror(err));
-      continue;
-    }
-    llvm::outs()
-        << f->getName()
-        << " ('" << sub->getName() << "')"
-        << " : " << path.string() << ":"
-        << sub->getLine() << " ["
-        << (is_unsafe ? "unsafe" : "safe")
-        << "]\n";
-    if (is_unsafe)
-    {
-      unsafe_functions.push_back(f);
-    }
-  }
-  find_unsafe_rs_free(find_unsafe_rs);
-  return unsafe_functions;
+  TaintConfigData taint_config_data;
+  taint_config_data.Functions.push_back(
+      FunctionData{
+          .Name = "sink",
+          .HasAllSinkParam = true,
+      });
+  return taint_config_data;
 }
 
-/// @brief Convert IFDS leak map to XTaint leak map for uniform data structure
-psr::XTaint::LeakMap_t convert_leaks(std::map<const llvm::Instruction *, std::set<const llvm::Value *>> &leaks)
+/// @brief Run the IFDS and IDE taint analyses with one taint config
+void run_taint_analyses(HelperAnalyses &HA, const std::string &config_name, const TaintConfigData &taint_config_data, const UnsafeCode &unsafe_code, const bool parallel)
 {
-  auto map = psr::XTaint::LeakMap_t();
-  for (const auto l : leaks)
-  {
-    auto set = llvm::SmallSet<const llvm::Value *, 1U>();
-    for (const auto v : l.second)
-    {
-      set.insert(v);
-    }
-    map.emplace(std::make_pair(l.first, set));
-  }
-  return map;
+  TaintRunOptions opts;
+  opts.Parallel = parallel;
+  run_taint_config(HA, config_name, taint_config_data, &unsafe_code, opts, llvm::outs());
 }
 
-void print_leaks(psr::XTaint::LeakMap_t &leaks)
+void print_usage()
 {
-  for (const auto l : leaks)
-  {
-    llvm::outs() << "IR: " << *l.first << " -> Leaks values: \n";
-    for (const auto v : l.second)
-    {
-      llvm::outs() << " -> Value: " << *v << "\n";
-    }
-  }
-  llvm::outs() << "\n";
+  llvm::errs() << "unsafe-taint-check \n"
+                  "A small PhASAR-based program to check the unsafe taint for rust\n\n"
+                  "Usage: unsafe-taint-check <LLVM IR file> [--cache-dir <dir>] [--config <taint config>...] [--stats <path>] [--sequential]\n"
+                  "--sequential solves the IFDS and IDE taint problems one after the other instead of in parallel\n";
 }
 
 int main(int argc, const char **argv)
@@ -102,15 +61,54 @@ int main(int argc, const char **argv)
   if (argc < 2 || !std::filesystem::exists(argv[1]) ||
       std::filesystem::is_directory(argv[1]))
   {
-    llvm::errs() << "unsafe-taint-check \n"
-                    "A small PhASAR-based program to check the unsafe taint for rust\n\n"
-                    "Usage: unsafe-taint-check <LLVM IR file>\n";
+    print_usage();
     return 1;
   }
 
   std::vector entrypoints = {"main"s};
 
-  HelperAnalyses HA(argv[1], entrypoints);
+  std::string cache_dir;
+  std::vector<std::string> config_files;
+  std::string stats_file;
+  bool parallel = true;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (argv[i] == "--sequential"s)
+    {
+      parallel = false;
+      continue;
+    }
+    // all other flags take a value
+    if (i + 1 >= argc)
+    {
+      print_usage();
+      return 1;
+    }
+    if (argv[i] == "--cache-dir"s)
+    {
+      cache_dir = argv[++i];
+    }
+    else if (argv[i] == "--config"s)
+    {
+      config_files.push_back(argv[++i]);
+    }
+    else if (argv[i] == "--stats"s)
+    {
+      stats_file = argv[++i];
+    }
+    else
+    {
+      print_usage();
+      return 1;
+    }
+  }
+  if (!stats_file.empty())
+  {
+    Instrumentation::global().enableSummary("unsafe-taint-check", stats_file);
+  }
+
+  auto HA_ptr = load_helper_analyses(argv[1], entrypoints, cache_dir);
+  auto &HA = *HA_ptr;
 
   const auto *F = HA.getProjectIRDB().getFunctionDefinition("main");
   if (!F)
@@ -120,76 +118,28 @@ int main(int argc, const char **argv)
   }
 
   // HA.getICFG().print();
-  auto unsafe_functions = get_unsafe_functions(HA);
-  llvm::outs() << "\nUnsafe functions:\n";
-  for (auto f : unsafe_functions)
+  const auto unsafe_code = find_unsafe_code(HA.getICFG().getAllFunctions(), &llvm::outs(), cache_dir);
+  llvm::outs() << "\nUnsafe functions (" << unsafe_code.Instructions.size() << " unsafe instructions):\n";
+  for (auto f : unsafe_code.Functions)
   {
-    llvm::outs() << f->getName() << "\n";
+    llvm::outs() << f->getName() << " (" << DemangleCache::global().demangle(f) << ")\n";
   }
 
   PHASAR_LOG_LEVEL(INFO, "Testing IFDS taint analysis with unsafe functions as source:");
 
-  TaintConfigData taint_config_data;
-  for (auto f : unsafe_functions)
+  // the name index is built once, all configs are analyzed on the same module
+  const FunctionNameIndex function_index(HA.getICFG().getAllFunctions());
+  const auto configs = taint_configs(config_files, default_taint_config, function_index, /* AddDropSinks */ false);
+  if (!configs)
   {
-    // all sret(%Type) marked arguments are considered return values and therefore tainted
-    // fill vec<int> with int if f->args()[i].getParamStructRetType() != NULL
-    std::vector<unsigned int> sretArgs;
-    unsigned int arg_num = 0;
-    for (auto &arg : f->args())
-    {
-      if (arg.hasStructRetAttr())
-      {
-        sretArgs.push_back(arg_num);
-      }
-      arg_num++;
-    }
-
-    taint_config_data.Functions.push_back(
-        FunctionData{
-            .Name = f->getName().str(),
-            .ReturnCat = TaintCategory::Source,
-            .SourceValues = sretArgs,
-        });
+    return 1;
   }
-  taint_config_data.Functions.push_back(
-      FunctionData{
-          .Name = "sink",
-          .HasAllSinkParam = true,
-      });
-
-  LLVMTaintConfig taint_config(HA.getProjectIRDB(), taint_config_data);
-  llvm::outs() << "taint config:\n"
-               << taint_config << "\n";
-
-  IFDSTaintAnalysis ifds_taint_problem(&HA.getProjectIRDB(), &HA.getAliasInfo(), &taint_config);
 
-  PHASAR_LOG_LEVEL(INFO, "Solving IFDSTaintAnalysis taint problem");
-  IFDSSolver S(ifds_taint_problem, &HA.getICFG());
-  auto IFDSResults = S.solve();
-  // IFDSResults.dumpResults(HA.getICFG());
-
-  auto ifds_taint_leaks = convert_leaks(ifds_taint_problem.Leaks);
-  llvm::outs() << "\n"
-               << ifds_taint_leaks.size()
-               << " leaks found using IFDS Taint:\n";
-  print_leaks(ifds_taint_leaks);
-
-  PHASAR_LOG_LEVEL(INFO, "Testing IDE extended taint analysis with unsafe functions as source:");
-
-  const std::vector<std::string> entry_points = {"main"};
-  auto ide_xtaint_problem =
-      createAnalysisProblem<IDEExtendedTaintAnalysis<>>(HA, taint_config, entry_points);
-
-  PHASAR_LOG_LEVEL(INFO, "Solving IDEXTaintAnalysis taint problem");
-  IDESolver IDE_S(ide_xtaint_problem, &HA.getICFG());
-  auto IDEResults = IDE_S.solve();
-
-  auto ide_xtaint_leaks = ide_xtaint_problem.getAllLeaks(IDEResults);
-  llvm::outs() << "\n"
-               << ide_xtaint_leaks.size()
-               << " leaks found using IDE XTaint:\n";
-  print_leaks(ide_xtaint_leaks);
+  for (const auto &[config_name, taint_config_data] : *configs)
+  {
+    llvm::outs() << "\n\n###########\n\nTaint config " << config_name << ":\n\n";
+    run_taint_analyses(HA, config_name, taint_config_data, unsafe_code, parallel);
+  }
 
   return 0;
-}
\ No newline at end of file
+}